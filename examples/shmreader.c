@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * This file is part of Inovesa (github.com/Inovesa/Inovesa).
+ * It's copyrighted by the contributors recorded
+ * in the version control history of the file.
+ */
+
+/*
+ * Example reader for the shared memory output of Inovesa
+ * (see inc/IO/SharedMemoryLayout.h), e.g.
+ *
+ *   inovesa -c config.cfg --SharedMemory /inovesa &
+ *   inovesa-shmreader /inovesa 10
+ *
+ * prints CSR intensity and peak of the bunch profile (of the first bunch)
+ * for the next 10 published steps.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "IO/SharedMemoryLayout.h"
+
+static void wait_a_bit(void)
+{
+    const struct timespec ms = {0, 1000000};
+    nanosleep(&ms, NULL);
+}
+
+/* i-th element of the array as double */
+static double value(const char* data, const InovesaSHMArray* array, size_t i)
+{
+    if (array->type == INOVESA_SHM_FLOAT32) {
+        return ((const float*) (data + array->offset))[i];
+    }
+    return ((const double*) (data + array->offset))[i];
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s name [steps]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const long steps = (argc > 2) ? atol(argv[2]) : -1;
+
+    const int fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(InovesaSHMHeader)) {
+        fprintf(stderr, "Shared memory is not ready.\n");
+        return EXIT_FAILURE;
+    }
+    const char* mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    const InovesaSHMHeader* header = (const InovesaSHMHeader*) mem;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != INOVESA_SHM_MAGIC
+            || header->version != INOVESA_SHM_VERSION) {
+        fprintf(stderr, "Unknown format.\n");
+        return EXIT_FAILURE;
+    }
+    const InovesaSHMArray* arrays = (const InovesaSHMArray*) (header + 1);
+    const InovesaSHMArray* profile = NULL;
+    const InovesaSHMArray* intensity = NULL;
+    for (uint32_t a = 0; a < header->narrays; a++) {
+        printf("%s:", arrays[a].name);
+        for (uint32_t d = 0; d < arrays[a].rank; d++) {
+            printf(" %u", arrays[a].dims[d]);
+        }
+        printf("\n");
+        if (strcmp(arrays[a].name, "BunchProfile") == 0) {
+            profile = &arrays[a];
+        } else if (strcmp(arrays[a].name, "CSRIntensity") == 0) {
+            intensity = &arrays[a];
+        }
+    }
+
+    /* published data is copied, so that it can be used while
+     * the slot is overwritten */
+    char* copy = malloc(header->slotbytes);
+    uint64_t last = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+    for (long received = 0; steps < 0 || received < steps; ) {
+        const uint64_t n = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        if (n == last) {
+            wait_a_bit();
+            continue;
+        }
+        if (n > last + 1) {
+            printf("(missed %llu steps)\n", (unsigned long long) (n - last - 1));
+        }
+        last = n;
+
+        const char* slotdata = mem + header->slotoffset
+                             + (n - 1) % header->nslots * header->slotbytes;
+        const InovesaSHMSlot* slot = (const InovesaSHMSlot*) slotdata;
+        const uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        memcpy(copy, slotdata, header->slotbytes);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        const uint64_t after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+        if (before != 2 * n || after != before) {
+            /* the writer has already reused the slot */
+            continue;
+        }
+        received++;
+
+        const InovesaSHMSlot* data = (const InovesaSHMSlot*) copy;
+        double peak = 0;
+        for (uint32_t x = 0; profile != NULL && x < profile->dims[1]; x++) {
+            const double v = value(copy, profile, x);
+            peak = (v > peak) ? v : peak;
+        }
+        printf("step %llu, t=%g: CSR intensity %g, profile peak %g\n",
+               (unsigned long long) data->step, data->time,
+               (intensity != NULL) ? value(copy, intensity, 0) : 0.0, peak);
+        fflush(stdout);
+    }
+    free(copy);
+    munmap((void*) mem, st.st_size);
+
+    return EXIT_SUCCESS;
+}
@@ -33,9 +33,13 @@ typedef std::shared_ptr<OCLH> oclhptr_t;
 #include <clFFT.h>
 #endif // INOVESA_USE_CLFFT
 
+#include <algorithm>
 #include <climits>
 #include <list>
 #include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
 
 /**
  * Picks the last available platform.
@@ -53,14 +57,44 @@ public:
         dev2cpu
     };
 
+    /**
+     * @brief The Access struct lists buffers used by a command
+     *
+     * In out-of-order mode, commands wait for exactly those earlier
+     * commands that write what they read or use what they write.
+     */
+    struct Access {
+        cl::vector<cl::Memory> read;
+        cl::vector<cl::Memory> write;
+    };
+
     /**
      * @brief prepareCLEnvironment
      * @param device
      * @param glsharing needs to be implemented
+     * @param outoforder use out-of-order queue (if supported by device)
+     * @param retune benchmark work-group sizes even if results are stored
+     * @param ndevices number of devices to distribute column blocks over
+     *
+     * For ndevices > 1, device is partitioned into sub-devices
+     * (device fission) if possible. Otherwise, the devices following
+     * device on the same platform are used in addition.
+     * These are only used by enqueueColumnBlocks(), all other commands
+     * go to (the undivided) device.
      */
-    OCLH( uint32_t device, bool glsharing=false);
+    OCLH( uint32_t device, bool glsharing=false, bool outoforder=false
+        , bool retune=false, uint32_t ndevices=1);
 
-    cl::Program prepareCLProg(std::string);
+    /**
+     * @brief prepareCLProg builds an OpenCL program
+     * @param code source code (without the common data type definitions)
+     *
+     * Programs are shared within the process, so building the same code
+     * twice returns the same program. Binaries are cached on disk (in
+     * FSPath::datapath()/clprograms), identified by the code, device,
+     * driver and build options.
+     */
+    cl::Program prepareCLProg(std::string code);
 
     ~OCLH();
 
@@ -78,6 +112,81 @@ public:
     bool OpenGLSharing() const
         { return ogl_sharing; }
 
+    /**
+     * @brief outOfOrder
+     * @return true if dependencies are resolved by events instead of order
+     */
+    bool outOfOrder() const
+        { return _outoforder; }
+
+    /**
+     * @brief maxWorkGroupSize
+     * @return largest work-group size kernel can be launched with
+     */
+    size_t maxWorkGroupSize(const cl::Kernel& kernel) const
+        { return kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(_device); }
+
+    /**
+     * @brief localMemSize
+     * @return size of local memory (in bytes) per work-group
+     */
+    size_t localMemSize() const
+        { return _device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>(); }
+
+    /**
+     * @brief devices
+     * @return number of devices kernels might be distributed over
+     */
+    size_t devices() const
+        { return std::max<size_t>(_blockqueues.size(),1); }
+
+    /**
+     * @brief The ColumnArg struct is a kernel argument split into blocks
+     */
+    struct ColumnArg {
+        cl_uint index;
+        cl::Buffer buffer;
+        size_t colbytes;
+    };
+
+    /**
+     * @brief enqueueColumnBlocks distributes a kernel over all devices
+     * @param access buffers used by the kernel
+     * @param kernel uses one work-group per column (get_group_id(0))
+     * @param columns kernel arguments holding per-column data
+     * @param ncols number of columns
+     * @param local work-group size
+     *
+     * Every device gets a block of columns. It works on sub-buffers
+     * (that do not overlap) of the buffers in columns, so that columns
+     * are numbered from zero within every block. The whole buffers
+     * are used, if there is only one device.
+     */
+    void enqueueColumnBlocks( const Access& access
+                            , cl::Kernel& kernel
+                            , const std::vector<ColumnArg>& columns
+                            , const size_t ncols
+                            , const size_t local
+                            #if INOVESA_ENABLE_CLPROFILING == 1
+                            , cl::vector<cl::Event*>* timings = nullptr
+                            #endif // INOVESA_ENABLE_CLPROFILING
+                            );
+
+    /**
+     * @brief localSize work-group size to launch kernel with
+     * @param access buffers used by the kernel
+     * @param global global size the kernel will be launched with
+     *
+     * Candidate sizes are benchmarked once per kernel, device and
+     * global size. Results are stored next to the program binaries
+     * (in FSPath::datapath()/clprograms) and reused by later runs.
+     * Benchmarking executes the kernel with its current arguments,
+     * so kernels that write buffers they read are never tuned.
+     */
+    cl::NDRange localSize( const Access& access
+                         , const cl::Kernel& kernel
+                         , const cl::NDRange& global);
+
 private:
     cl::Platform _platform;
 
@@ -85,6 +194,18 @@ private:
 
     cl::Device _device;
 
+    /**
+     * @brief _blockdevices devices of _blockqueues (empty if not split)
+     */
+    cl::vector<cl::Device> _blockdevices;
+
+    /**
+     * @brief _usedDevices _device, followed by other devices of _blockqueues
+     *
+     * Programs are built for these.
+     */
+    cl::vector<cl::Device> _usedDevices;
+
     cl_device_type devicetype;
 
     /**
@@ -92,8 +213,84 @@ private:
      */
     cl::CommandQueue queue;
 
+    /**
+     * @brief _blockqueues one queue per device of _blockdevices
+     *
+     * Only used by enqueueColumnBlocks(), all other commands go to queue.
+     */
+    std::vector<cl::CommandQueue> _blockqueues;
+
+    /**
+     * @brief _blockalign base address alignment (in bytes) of sub-buffers,
+     *        valid for all _blockdevices
+     */
+    size_t _blockalign;
+
+    /**
+     * @brief _subbuffers used by enqueueColumnBlocks(),
+     *        indexed by parent buffer, offset, and size
+     *
+     * Reusing the sub-buffers makes sure that the same region
+     * is always accessed through the same object.
+     */
+    std::map<std::tuple<cl_mem,size_t,size_t>,cl::Buffer> _subbuffers;
+
     bool ogl_sharing;
 
+    bool _outoforder;
+
+    /**
+     * @brief _retune ignore stored work-group sizes
+     */
+    const bool _retune;
+
+    /**
+     * @brief _deviceid identifies platform, device and driver
+     */
+    std::string _deviceid;
+
+    /**
+     * @brief _worksizes tuned local sizes, indexed by kernel and global size
+     */
+    std::map<std::string,cl::NDRange> _worksizes;
+
+    struct LocalSize {
+        cl::NDRange global;
+        cl::NDRange local;
+    };
+
+    /**
+     * @brief _localsizes last result of localSize(), indexed by kernel
+     */
+    std::map<cl_kernel,LocalSize> _localsizes;
+
+    /**
+     * @brief number of launches timed per candidate work-group size
+     */
+    static constexpr uint32_t _tuningreps = 10;
+
+    /**
+     * @brief The BufferState struct holds events of commands using a buffer
+     */
+    struct BufferState {
+        cl::Event write;
+        cl::vector<cl::Event> reads;
+    };
+
+    std::map<cl_mem,BufferState> _bufferstate;
+
+    /**
+     * @brief _waitlist collects events a command with access has to wait for
+     * @param events additional events given by the caller (may be nullptr)
+     */
+    cl::vector<cl::Event> _waitlist( const Access& access
+                                   , const cl::vector<cl::Event>* events);
+
+    /**
+     * @brief _record remembers event as last use of the buffers in access
+     */
+    void _record(const Access& access, const cl::Event& event);
+
     #if INOVESA_ENABLE_CLPROFILING == 1
     void saveProfilingInfo(std::string fname);
 
@@ -123,14 +320,25 @@ public:
         #if INOVESA_ENABLE_CLPROFILING == 1
         cl::Event* event = new cl::Event();
         timingsDFT.push_back(event);
+        #else
+        cl::Event localevent;
+        cl::Event* event = &localevent;
         #endif // INOVESA_ENABLE_CLPROFILING
-        clfftEnqueueTransform(plHandle,dir,1,&queue(),0,nullptr,
-                              #if INOVESA_ENABLE_CLPROFILING == 1
+        const Access access{{inputBuffer},{outputBuffer}};
+        cl::vector<cl_event> waitlist;
+        if (_outoforder) {
+            for (auto& ev : _waitlist(access,nullptr)) {
+                waitlist.push_back(ev());
+            }
+        }
+        clfftEnqueueTransform(plHandle,dir,1,&queue(),
+                              waitlist.size(),
+                              waitlist.empty()? nullptr : waitlist.data(),
                               &(*event)(),
-                              #else
-                              nullptr,
-                              #endif
                               &inputBuffer(),&outputBuffer(),nullptr);
+        if (_outoforder) {
+            _record(access,*event);
+        }
     }
     #endif // INOVESA_USE_CLFFT
 
@@ -146,6 +354,8 @@ public:
 
     /**
      * This wrapper function allows to centrally controll queuing kernels.
+     *
+     * As it is unknown what the kernel accesses, it is fenced by barriers.
      */
     inline void
     enqueueNDRangeKernel(const cl::Kernel& kernel,
@@ -169,11 +379,62 @@ public:
             timings->push_back(event);
         }
         #endif // INOVESA_ENABLE_CLPROFILING
+        if (_outoforder) {
+            enqueueBarrier();
+        }
         queue.enqueueNDRangeKernel(kernel,offset,global,local,events,event);
 
         enqueueBarrier();
     }
 
+    /**
+     * @brief enqueueNDRangeKernel for kernels with known buffer access
+     *
+     * In-order mode, this behaves like the version without access.
+     * Out-of-order, no barriers are used but the kernel only waits
+     * for the commands it depends on.
+     */
+    inline void
+    enqueueNDRangeKernel(const Access& access,
+                         const cl::Kernel& kernel,
+                         const cl::NDRange& offset,
+                         const cl::NDRange& global,
+                         const cl::NDRange& local = cl::NullRange,
+                         const cl::vector<cl::Event>* events = nullptr,
+                         cl::Event* event = nullptr
+                         #if INOVESA_ENABLE_CLPROFILING == 1
+                         , cl::vector<cl::Event*>* timings = nullptr
+                         #endif // INOVESA_ENABLE_CLPROFILING
+                         )
+    {
+        if (!_outoforder) {
+            enqueueNDRangeKernel(kernel,offset,global,local,events,event
+                                 #if INOVESA_ENABLE_CLPROFILING == 1
+                                 , timings
+                                 #endif // INOVESA_ENABLE_CLPROFILING
+                                 );
+            return;
+        }
+        cl::Event localevent;
+        if (event == nullptr) {
+            #if INOVESA_ENABLE_CLPROFILING == 1
+            event = new cl::Event();
+            #else
+            event = &localevent;
+            #endif // INOVESA_ENABLE_CLPROFILING
+        }
+        #if INOVESA_ENABLE_CLPROFILING == 1
+        if (timings == nullptr) {
+            timingsExecute.push_back(event);
+        } else {
+            timings->push_back(event);
+        }
+        #endif // INOVESA_ENABLE_CLPROFILING
+        const auto waitlist = _waitlist(access,events);
+        queue.enqueueNDRangeKernel(kernel,offset,global,local,&waitlist,event);
+        _record(access,*event);
+    }
+
     /**
      * This wrapper function allows to centrally controll queuing copyBuffer
      */
@@ -200,8 +461,20 @@ public:
             timings->push_back(event);
         }
         #endif // INOVESA_ENABLE_CLPROFILING
-        queue.enqueueCopyBuffer(src, dst, src_offset,dst_offset,size,
-                                events, event);
+        if (_outoforder) {
+            cl::Event localevent;
+            if (event == nullptr) {
+                event = &localevent;
+            }
+            const Access access{{src},{dst}};
+            const auto waitlist = _waitlist(access,events);
+            queue.enqueueCopyBuffer(src, dst, src_offset,dst_offset,size,
+                                    &waitlist, event);
+            _record(access,*event);
+        } else {
+            queue.enqueueCopyBuffer(src, dst, src_offset,dst_offset,size,
+                                    events, event);
+        }
     }
 
     /**
@@ -230,8 +503,20 @@ public:
             timings->push_back(event);
         }
         #endif // INOVESA_ENABLE_CLPROFILING
-        queue.enqueueReadBuffer(buffer, blocking, src_offset,size,ptr,
-                                events, event);
+        if (_outoforder) {
+            cl::Event localevent;
+            if (event == nullptr) {
+                event = &localevent;
+            }
+            const Access access{{buffer},{}};
+            const auto waitlist = _waitlist(access,events);
+            queue.enqueueReadBuffer(buffer, blocking, src_offset,size,ptr,
+                                    &waitlist, event);
+            _record(access,*event);
+        } else {
+            queue.enqueueReadBuffer(buffer, blocking, src_offset,size,ptr,
+                                    events, event);
+        }
     }
 
     /**
@@ -260,13 +545,54 @@ public:
             timings->push_back(event);
         }
         #endif // INOVESA_ENABLE_CLPROFILING
-        queue.enqueueWriteBuffer(buffer, blocking, src_offset,size,ptr,
-                                events, event);
+        if (_outoforder) {
+            cl::Event localevent;
+            if (event == nullptr) {
+                event = &localevent;
+            }
+            const Access access{{},{buffer}};
+            const auto waitlist = _waitlist(access,events);
+            queue.enqueueWriteBuffer(buffer, blocking, src_offset,size,ptr,
+                                    &waitlist, event);
+            _record(access,*event);
+        } else {
+            queue.enqueueWriteBuffer(buffer, blocking, src_offset,size,ptr,
+                                    events, event);
+        }
     }
 
+    /**
+     * @brief enqueueDownload reads a buffer to the host without blocking
+     * @param buffer device buffer to read (from offset 0)
+     * @param size number of bytes
+     * @param dst where finishDownloads() will put the data
+     *
+     * Data is read to pinned staging memory (allocated once per buffer),
+     * so the transfer can overlap with kernels enqueued later.
+     */
+    void enqueueDownload(const cl::Buffer& buffer, size_t size, void* dst);
+
+    /**
+     * @brief finishDownloads waits for pending downloads
+     *        and copies the data to their destinations
+     */
+    void finishDownloads();
+
+    /**
+     * @brief enqueueUpload writes a buffer without blocking
+     * @param buffer device buffer to write (from offset 0)
+     * @param size number of bytes
+     * @param src data, may be changed as soon as the call returns
+     *
+     * The data is first copied to pinned staging memory.
+     */
+    void enqueueUpload(const cl::Buffer& buffer, size_t size, const void* src);
+
     inline void finish()
     {
         queue.finish();
+        // all commands are done, so there is no need to wait for them
+        _bufferstate.clear();
     }
 
     inline void flush()
@@ -293,7 +619,75 @@ private:
 
     static const std::string custom_datatypes;
 
+    /**
+     * @brief _programs already built in this process, indexed by full code
+     */
+    std::map<std::string,cl::Program> _programs;
+
+    /**
+     * @brief The Staging struct is pinned host memory used for transfers
+     */
+    struct Staging {
+        cl::Buffer pinned;
+        void* host = nullptr;
+        size_t size = 0;
+        cl::Event pending;
+    };
+
+    /**
+     * @brief _staging memory, indexed by device buffer
+     */
+    std::map<cl_mem,Staging> _staging;
+
+    struct Download {
+        cl::Event event;
+        const void* src;
+        void* dst;
+        size_t size;
+    };
+
+    std::vector<Download> _downloads;
+
 private: // helper functions
+    /**
+     * @brief _stagingFor buffer, at least size bytes, not in use anymore
+     */
+    Staging& _stagingFor(const cl::Buffer& buffer, size_t size);
+
+    bool loadCLProgBinary( const std::vector<std::string>& ids
+                         , const std::string& buildopts
+                         , cl::Program& p);
+
+    /**
+     * @brief saveCLProgBinary stores binaries of p for all _usedDevices
+     * @param ids identify the binary for each of _usedDevices
+     */
+    void saveCLProgBinary( const std::vector<std::string>& ids
+                         , const cl::Program& p) const;
+
+    /**
+     * @brief programFile cache file (in FSPath::datapath()/clprograms)
+     *        for the program binary identified by id
+     */
+    static std::string programFile(const std::string& id);
+
+    /**
+     * @brief deviceId identifies platform, device and driver
+     */
+    std::string deviceId(const cl::Device& device) const;
+
+    std::string workSizesFile() const;
+
+    void loadWorkSizes();
+
+    void saveWorkSizes() const;
+
+    /**
+     * @brief benchmarkLocalSize finds the fastest local size for kernel
+     */
+    cl::NDRange benchmarkLocalSize( const cl::Kernel& kernel
+                                  , const cl::NDRange& global);
+
     static std::string datatype_aliases();
 
     static std::vector<cl_context_properties> properties(cl::Platform& platform,
@@ -10,6 +10,7 @@
 #include "defines.hpp"
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <exception>
 #include <fstream>
@@ -79,7 +80,12 @@ public:
      */
     static std::chrono::system_clock::time_point start_time;
 
-    volatile static bool abort;
+    /**
+     * @brief abort stops the simulation when set
+     *
+     * Atomic, as it is also set by the HDF5 writer thread.
+     */
+    static std::atomic<bool> abort;
 
 public:
     Display() = delete;
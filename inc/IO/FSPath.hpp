@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <functional>
+#include <ostream>
 #include <string>
 #include <boost/filesystem.hpp>
 
@@ -38,6 +40,25 @@ public:
 
     static std::string datapath();
 
+    /**
+     * @brief hexhash FNV-1a hash (stable between runs and platforms)
+     * @return hash as 16 hex digits, e.g. for names of cache files
+     */
+    static std::string hexhash(const std::string& str);
+
+    /**
+     * @brief writeAtomically writes to a temporary file that is renamed
+     * @param path final name of the file
+     * @param write function writing the content (to a binary stream)
+     * @return true if the file has been written
+     *
+     * Concurrent runs (e.g. of a current scan) never see incomplete files.
+     * Failing (e.g. in a read-only directory) is reported but no error,
+     * as written files are (caches) for optimization only.
+     */
+    static bool writeAtomically( const std::string& path
+                               , std::function<void(std::ostream&)> write);
+
 private:
     static std::string expand_user(std::string path);
 
@@ -10,9 +10,18 @@
 #if INOVESA_USE_HDF5 == 1
 
 #include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <H5Cpp.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "defines.hpp"
 #include "PS/ElectricField.hpp"
@@ -25,6 +34,117 @@ namespace vfps {
 class HDF5File
 {
 public:
+    /**
+     * @brief The StorageSettings struct describes how a dataset is stored
+     */
+    struct StorageSettings {
+        /// deflate level (0: no compression)
+        uint32_t compression;
+
+        bool shuffle;
+
+        /// chunk dimensions (empty: use defaults)
+        std::vector<hsize_t> chunkdims;
+
+        /// chunk cache in bytes (0: one row of chunks, up to maxbufferbytes)
+        size_t chunkcache;
+    };
+
+    /**
+     * @brief The OutputProfile struct collects storage settings
+     *
+     * Profiles are "fast" (light compression, chunks of single rows
+     * for large datasets), "balanced", and "archive" (strong compression).
+     * Overrides have the form "Dataset:key=value,...;...",
+     * e.g. "PhaseSpace:compression=9,chunk=1x1x128x128;CSR/Spectrum:shuffle=0".
+     * Keys are compression, shuffle, chunk, and cache (in MiB).
+     */
+    struct OutputProfile {
+        /**
+         * @throws std::invalid_argument for unknown names or settings,
+         *         missing dataset names, or compression levels above 9
+         */
+        OutputProfile( const std::string& name="balanced"
+                     , const std::string& overrides="");
+
+        /**
+         * @brief get settings
+         * @param dataset full name, e.g. "/PhaseSpace/data"
+         */
+        StorageSettings get(const std::string& dataset) const;
+
+        std::string name;
+
+        std::string overrides;
+
+        StorageSettings defaults;
+
+        /// large datasets are chunked by single rows (in time)
+        bool rowchunks;
+
+        /**
+         * @brief quantize save phase space and profiles as uint16
+         *
+         * Every bunch of every step is stored with its own scaling,
+         * see _appendQuantized().
+         */
+        bool quantize;
+
+        /**
+         * @brief snapshots save phase space cropped to the occupied cells
+         *
+         * See _appendSnapshot(), cannot be combined with quantize.
+         */
+        bool snapshots;
+
+        /// cells below this fraction of the maximum are regarded empty
+        double snapshotthreshold;
+
+        /// every n'th snapshot is a keyframe (1: no differences)
+        uint32_t keyframeinterval;
+
+        std::map<std::string,StorageSettings> datasets;
+    };
+
+    /**
+     * @brief The SpectrumSettings struct selects the saved CSR spectrum
+     *
+     * Frequencies outside [fmin,fmax] are dropped. If bins is non-zero,
+     * the remaining spectrum is averaged to that number of bins.
+     */
+    struct SpectrumSettings {
+        SpectrumSettings( const double fmin=0
+                        , const double fmax=0
+                        , const uint32_t bins=0
+                        , const bool logarithmic=false)
+          : fmin(fmin), fmax(fmax), bins(bins), logarithmic(logarithmic)
+        {}
+
+        /// lowest saved frequency (in Hz)
+        double fmin;
+
+        /// highest saved frequency (in Hz, 0: no limit)
+        double fmax;
+
+        /// number of frequency bins (0: save every frequency)
+        uint32_t bins;
+
+        /// logarithmically (instead of linearly) spaced bins
+        bool logarithmic;
+    };
+
+    /**
+     * @brief The OutputGroup enum lists results saved at a common cadence
+     *
+     * Moments (bunch length and position, energy spread and average,
+     * bunch population, and CSR intensity) use /Info/AxisValues_t.
+     * The groups listed here can be saved at other times,
+     * they then get their own time axis.
+     */
+    enum class OutputGroup : uint_fast16_t {
+        Profiles, Spectra, Wake, Tracks
+    };
+
     /**
      * @brief HDF5File
      * @param filename file name to save HDF5 file to
@@ -34,6 +154,19 @@ public:
      * @param wfm wake
      * @param nparticles
      * @param t_sync
+     * @param asyncbytes memory to buffer data for writing by a background
+     *                   thread (0: write synchronously)
+     * @param compressionthreads threads to compress chunks
+     *                           (0: let HDF5 compress)
+     * @param profile storage settings of datasets
+     * @param swmrinterval seconds between flushes in SWMR mode
+     *                     (0: do not use SWMR)
+     * @param spectrum part of the CSR spectrum to save
+     * @param ownaxes groups not saved together with the moments
+     *
+     * In SWMR (single writer, multiple readers) mode, the file can be read
+     * while results are appended. SWMR writing starts with the first
+     * appended data, so no parameters can be added afterwards.
      */
     HDF5File(const std::string filename,
              const std::shared_ptr<PhaseSpace> ps,
@@ -42,9 +175,23 @@ public:
              const WakeFunctionMap *wfm,
              const size_t nparticles,
              const double t_sync,
-             const double f_rev);
+             const double f_rev,
+             const size_t asyncbytes=0,
+             const uint32_t compressionthreads=0,
+             const OutputProfile profile=OutputProfile(),
+             const uint32_t swmrinterval=0,
+             const SpectrumSettings spectrum=SpectrumSettings(),
+             const std::set<OutputGroup> ownaxes=std::set<OutputGroup>());
+
+    /**
+     * @brief ~HDF5File writes all queued data before closing the file
+     */
+    ~HDF5File();
 
-    ~HDF5File() = default;
+    /**
+     * @brief flush blocks until all queued data is written
+     */
+    void flush();
 
     void addParameterToGroup(std::string groupname,
                              std::string paramname,
@@ -54,9 +201,21 @@ public:
     /**
      * @brief append synchrotron radiation data
      * @param ef electric fild used for CSR computation
-     * @param fullspectrum safe full CSR spectrum or only integrated power
+     * @param t time (in units of synchrotron periods)
+     * @param intensity save integrated power
+     * @param spectrum save CSR spectrum
+     */
+    void append( const ElectricField* ef, const timeaxis_t t
+               , const bool intensity = true, const bool spectrum = true);
+
+    /**
+     * @brief appendCSRIntensity append CSR intensity only
+     * @param ef electric fild used for CSR computation
+     * @param t time (in units of synchrotron periods)
+     *
+     * Meant to be called every simulation step, so it has its own time axis.
      */
-    void append(const ElectricField* ef, const bool fullspectrum = true);
+    void appendCSRIntensity(const ElectricField* ef, const timeaxis_t t);
 
     /**
      * @brief savePaddedProfile
@@ -71,20 +230,23 @@ public:
      * All: save everything
      * Defaults: (no phase space)
      * PhaseSpace: phase space only
+     * Moments: bunch length, energy spread, etc. only
+     * Profiles: bunch and energy profile only
      */
     enum class AppendType : uint_fast16_t {
-        All, Defaults, PhaseSpace
+        All, Defaults, PhaseSpace, Moments, Profiles
     };
 
     void appendRFKicks(const std::vector<std::array<vfps::meshaxis_t,2>> kicks);
 
-    void appendTracks(const std::vector<PhaseSpace::Position> &p);
+    void appendTracks( const std::vector<PhaseSpace::Position> &p
+                     , const timeaxis_t t);
 
     void append(const PhaseSpace& ps,
                 const timeaxis_t t,
                 const AppendType at=AppendType::Defaults);
 
-    void append(const WakeKickMap* wkm);
+    void append(const WakeKickMap* wkm, const timeaxis_t t);
 
 public:
     static std::unique_ptr<PhaseSpace>
@@ -103,20 +265,54 @@ private:
         DatasetInfo() = delete;
         DatasetInfo( H5::DataSet dataset
                    , H5::DataType datatype
-                   , std::array<hsize_t,N> dims)
-        : dataset(dataset), datatype(datatype), dims(dims)
+                   , std::array<hsize_t,N> dims
+                   , std::array<hsize_t,N> chunkdims
+                   , const StorageSettings& settings
+                   , hsize_t bufferrows=1)
+        : dataset(dataset), datatype(datatype)
+        , elemsize(datatype.getSize()), dims(dims)
+        , chunkdims(chunkdims)
+        , compression(settings.compression), shuffle(settings.shuffle)
+        , bufferrows(bufferrows), buffered(0)
         {}
 
         static constexpr int rank = N;
         const H5::DataSet dataset;
         const H5::DataType datatype;
+
+        /**
+         * @brief elemsize size of datatype in bytes
+         *
+         * Known without calling HDF5, which must not be used
+         * concurrently with the writer thread.
+         */
+        const size_t elemsize;
         std::array<hsize_t,N> dims;
+        const std::array<hsize_t,N> chunkdims;
+        const uint32_t compression;
+        const bool shuffle;
+
+        /**
+         * @brief bufferrows number of rows collected before writing
+         *
+         * Appended rows are kept in buffer until a whole chunk
+         * can be written, so that the dataset is extended once per chunk.
+         */
+        const hsize_t bufferrows;
+        std::vector<char> buffer;
+        hsize_t buffered;
     };
 
     const std::string _fname;
 
+    const uint32_t _swmrinterval;
+
     H5::H5File _file;
 
+    bool _swmrstarted;
+
+    std::chrono::steady_clock::time_point _lastflush;
+
     const uint32_t _nBuckets;
 
     const uint32_t _nBunches;
@@ -129,9 +325,55 @@ private:
 
     const uint32_t _maxn;
 
+    /**
+     * @brief The SpectrumBin struct maps CSR spectrum to saved frequencies
+     *
+     * The saved value is the average over [first,last). For empty bins
+     * (last == first), it is interpolated between first and first+1.
+     */
+    struct SpectrumBin {
+        size_t first;
+        size_t last;
+        double weight;
+        frequency_t frequency;
+    };
+
+    /**
+     * @brief _spectrumBins saved frequencies (empty: full spectrum)
+     */
+    const std::vector<SpectrumBin> _spectrumBins;
+
+    /**
+     * @brief _nFreqs number of frequencies in saved CSR spectra
+     */
+    const uint32_t _nFreqs;
+
+    /**
+     * @brief _spectrum saved CSR spectra (all bunches)
+     */
+    std::vector<meshaxis_t> _spectrum;
+
     const uint32_t _impSize;
 
-    static constexpr uint_fast8_t compression = 6;
+    const OutputProfile _profile;
+
+    /**
+     * @brief _compressionthreads number of threads compressing chunks
+     *
+     * When non-zero, chunks are shuffled and deflated by Inovesa
+     * and written using H5Dwrite_chunk. Datasets are then chunked,
+     * so that rows are always written as whole chunks.
+     */
+    const uint32_t _compressionthreads;
+
+    /**
+     * @brief maxbufferbytes maximum size of the append buffer of a dataset
+     *
+     * Default chunks of datasets with large rows hold fewer rows,
+     * explicitly larger chunks are written row by row.
+     * Also limits the default chunk cache.
+     */
+    static constexpr size_t maxbufferbytes = 8*1024*1024;
 
 private: // values for phase space axis
 
@@ -175,24 +417,198 @@ private: // values for phase space axis
 
     DatasetInfo<2> _csrIntensity;
 
+    DatasetInfo<1> _timeAxisCSRStep;
+
+    DatasetInfo<2> _csrIntensityPerStep;
+
     DatasetInfo<4> _phaseSpace;
 
+    /**
+     * @brief quantization (offset and scale) of quantized datasets
+     *
+     * Only used when _profile.quantize is set.
+     */
+    std::unique_ptr<DatasetInfo<3>> _bunchProfileQuant;
+    std::unique_ptr<DatasetInfo<3>> _energyProfileQuant;
+    std::unique_ptr<DatasetInfo<3>> _phaseSpaceQuant;
+
+    std::vector<uint16_t> _quantized;
+
+    /**
+     * @brief snapshots of the phase space (see _appendSnapshot())
+     *
+     * Only used when _profile.snapshots is set.
+     */
+    std::unique_ptr<DatasetInfo<1>> _phaseSpaceValues;
+    std::unique_ptr<DatasetInfo<3>> _phaseSpaceIndex;
+
+    /**
+     * @brief _snapshotReference phase space as reconstructed from snapshots
+     */
+    std::vector<meshdata_t> _snapshotReference;
+
+    uint32_t _snapshotCount;
+
+    uint64_t _snapshotOffset;
+
+    /**
+     * @brief time axes of groups not saved together with the moments
+     */
+    std::unique_ptr<DatasetInfo<1>> _timeAxisProfiles;
+    std::unique_ptr<DatasetInfo<1>> _timeAxisSpectrum;
+    std::unique_ptr<DatasetInfo<1>> _timeAxisWake;
+    std::unique_ptr<DatasetInfo<1>> _timeAxisTracks;
+
     DatasetInfo<1> _impedanceReal;
     DatasetInfo<1> _impedanceImag;
 
     DatasetInfo<1> _wakeFunction;
 
 private:
+    /**
+     * @brief _appendData appends size rows of data to ds
+     *
+     * In asynchronous mode, data is copied to a buffer
+     * and written later by the writer thread.
+     */
     template <int rank, typename datatype>
     void _appendData( DatasetInfo<rank>& ds
                     , const datatype* const data
                     , const size_t size=1);
 
+    /**
+     * @brief _writeData adds rows to the buffer of ds, writes full chunks
+     */
+    template <int rank>
+    void _writeData( DatasetInfo<rank>& ds
+                   , const char* const data
+                   , const size_t size);
+
+    template <int rank>
+    void _writeRows( DatasetInfo<rank>& ds
+                   , const void* const data
+                   , const size_t size);
+
+    /**
+     * @brief _writeChunks compresses and appends rows as whole chunks
+     * @param size number of rows (multiple of chunk size)
+     *
+     * The dataset has to end at a chunk boundary.
+     */
+    template <int rank>
+    void _writeChunks( DatasetInfo<rank>& ds
+                     , const char* const data
+                     , const size_t size);
+
+    template <int rank>
+    void _flushBuffer(DatasetInfo<rank>& ds);
+
+    /**
+     * @brief _flushBuffers writes remaining rows of all datasets
+     */
+    void _flushBuffers();
+
+private: // asynchronous output
+    /**
+     * @brief _enqueue calls write with (a copy of) data
+     * @param write function accessing the file
+     * @param data to be passed to write
+     * @param bytes size of data
+     *
+     * If the queue is full (more than _asyncbytes are waiting),
+     * this blocks until the writer thread has caught up.
+     */
+    void _enqueue( std::function<void(const char*)> write
+                 , const void* data, const size_t bytes);
+
+    void _writeLoop();
+
+    /**
+     * @brief _swmrFlush makes appended data visible to SWMR readers
+     *
+     * Only acts when _swmrinterval has passed since the last flush.
+     * Buffers are written partially then, so the following writes
+     * complete that chunk before whole chunks are written again.
+     */
+    void _swmrFlush();
+
+    struct Job {
+        std::function<void(const char*)> write;
+        std::vector<char> data;
+    };
+
+    const size_t _asyncbytes;
+
+    std::deque<Job> _jobs;
+
+    /**
+     * @brief _pool buffers that can be reused for new jobs
+     */
+    std::vector<std::vector<char>> _pool;
+
+    size_t _queuedbytes;
+
+    bool _writing;
+
+    bool _stop;
+
+    std::mutex _mutex;
+
+    std::condition_variable _cv;
+
+    std::thread _writer;
+
+    /**
+     * @brief _appendSnapshot appends phase space to _phaseSpaceValues
+     *
+     * Every bunch is cropped to the bounding box of its occupied cells.
+     * Keyframes hold the values, other snapshots the bitwise XOR
+     * with the previous one (as reconstructed), so cells inside the
+     * box are restored exactly.
+     * Offset into the values, box (x0, nx, y0, ny), and whether it is
+     * a keyframe are saved to _phaseSpaceIndex.
+     */
+    void _appendSnapshot(const meshdata_t* const data);
+
+    /**
+     * @brief _appendQuantized appends data of every bunch as uint16
+     *
+     * Values are reconstructed as offset + scale*data,
+     * offset and scale are saved to quant (one pair per bunch and step).
+     */
+    template <int rank, typename datatype>
+    void _appendQuantized( DatasetInfo<rank>& ds
+                         , DatasetInfo<3>& quant
+                         , const datatype* const data);
+
+    /**
+     * @param quantized dataset will contain uint16 (see _appendQuantized)
+     */
     template<int rank, typename datatype>
     DatasetInfo<rank> _makeDatasetInfo( std::string name
                                       , std::array<hsize_t,rank> dims
                                       , std::array<hsize_t,rank> chunkdims
-                                      , std::array<hsize_t,rank> maxdims);
+                                      , std::array<hsize_t,rank> maxdims
+                                      , const bool quantized=false);
+
+    std::unique_ptr<DatasetInfo<3>> _makeQuantizationInfo(std::string name);
+
+    /**
+     * @brief _makeTimeAxisInfo creates a time axis (in synchrotron periods)
+     */
+    std::unique_ptr<DatasetInfo<1>> _makeTimeAxisInfo( std::string name
+                                                     , const double t_sync
+                                                     , const double f_rev);
+
+    /**
+     * @brief _makeSpectrumBins selects saved frequencies of the CSR spectrum
+     * @return empty vector if the full spectrum is saved
+     *
+     * @throws std::invalid_argument for an empty frequency window
+     */
+    std::vector<SpectrumBin>
+    _makeSpectrumBins( const ElectricField* ef
+                     , const SpectrumSettings& spectrum) const;
 
 
     H5::H5File _prepareFile();
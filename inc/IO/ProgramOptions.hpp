@@ -50,18 +50,99 @@ public:
     inline auto getCLDevice() const
         { return _cldevice; }
 
+    inline auto getCLOutOfOrder() const
+        { return _cloutoforder; }
+
+    inline auto getCLFusedStep() const
+        { return _clfusedstep; }
+
+    inline auto getCLDevices() const
+        { return _cldevices; }
+
+    inline auto getCLTune() const
+        { return _cltune; }
+
     inline auto getImpedanceFile() const
         { return _impedancefile; }
 
     inline auto getOutFile() const
         { return _outfile; }
 
+    inline auto getOutstepMoments() const
+        { return _outstep_moments; }
+
+    inline auto getOutstepProfiles() const
+        { return _outstep_profiles; }
+
+    inline auto getOutstepSpectra() const
+        { return _outstep_spectra; }
+
+    inline auto getOutstepWake() const
+        { return _outstep_wake; }
+
+    inline auto getOutstepTracks() const
+        { return _outstep_tracks; }
+
     inline auto getSavePhaseSpace() const
         { return _savephasespace; }
 
     inline auto getSaveSourceMap() const
         { return _savesourcemap; }
 
+    inline auto getCSRIntensityPerStep() const
+        { return _csrintensity_perstep; }
+
+    inline auto getCSRSpectrumFMin() const
+        { return _csrspectrum_fmin; }
+
+    inline auto getCSRSpectrumFMax() const
+        { return _csrspectrum_fmax; }
+
+    inline auto getCSRSpectrumBins() const
+        { return _csrspectrum_bins; }
+
+    inline auto getCSRSpectrumLogBins() const
+        { return _csrspectrum_logbins; }
+
+    inline auto getOutputBuffer() const
+        { return _outputbuffer; }
+
+    inline auto getCompressionLevel() const
+        { return _compressionlevel; }
+
+    inline auto getOutputProfile() const
+        { return _outputprofile; }
+
+    inline auto getOutputOverrides() const
+        { return _outputoverrides; }
+
+    inline auto getQuantizeOutput() const
+        { return _quantizeoutput; }
+
+    inline auto getPhaseSpaceSnapshots() const
+        { return _phasespacesnapshots; }
+
+    inline auto getSnapshotThreshold() const
+        { return _snapshotthreshold; }
+
+    inline auto getSnapshotKeyframes() const
+        { return _snapshotkeyframes; }
+
+    inline auto getSWMRInterval() const
+        { return _swmrinterval; }
+
+    inline auto getSharedMemory() const
+        { return _sharedmemory; }
+
+    inline auto getSharedMemorySlots() const
+        { return _sharedmemoryslots; }
+
+    inline auto getSharedMemoryPhaseSpace() const
+        { return _sharedmemoryphasespace; }
+
+    inline auto getCompressionThreads() const
+        { return _compressionthreads; }
+
     #if INOVESA_USE_OPENGL == 1
     inline auto getOpenGLVersion() const
         { return _glversion; }
@@ -216,14 +297,68 @@ public:
 private: // program parameters
     int32_t _cldevice;
 
+    bool _cloutoforder;
+
+    bool _clfusedstep;
+
+    uint32_t _cldevices;
+
+    bool _cltune;
+
     std::string _impedancefile;
 
     std::string _outfile;
 
+    uint32_t _outstep_moments;
+
+    uint32_t _outstep_profiles;
+
+    uint32_t _outstep_spectra;
+
+    uint32_t _outstep_wake;
+
+    uint32_t _outstep_tracks;
+
     uint32_t _savephasespace;
 
     bool _savesourcemap;
 
+    bool _csrintensity_perstep;
+
+    double _csrspectrum_fmin;
+
+    double _csrspectrum_fmax;
+
+    uint32_t _csrspectrum_bins;
+
+    bool _csrspectrum_logbins;
+
+    uint32_t _outputbuffer;
+
+    int32_t _compressionlevel;
+
+    std::string _outputprofile;
+
+    std::string _outputoverrides;
+
+    bool _quantizeoutput;
+
+    bool _phasespacesnapshots;
+
+    double _snapshotthreshold;
+
+    uint32_t _snapshotkeyframes;
+
+    uint32_t _swmrinterval;
+
+    std::string _sharedmemory;
+
+    uint32_t _sharedmemoryslots;
+
+    bool _sharedmemoryphasespace;
+
+    uint32_t _compressionthreads;
+
     bool _showphasespace;
 
     std::string _startdistfile;
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * This file is part of Inovesa (github.com/Inovesa/Inovesa).
+ * It's copyrighted by the contributors recorded
+ * in the version control history of the file.
+ */
+
+/*
+ * Layout of the shared memory ring buffer written by SharedMemorySink.
+ * This header is plain C, so that it can be used by external readers
+ * (see examples/shmreader.c).
+ *
+ * The shared memory object consists of
+ *   InovesaSHMHeader                 (at offset 0)
+ *   InovesaSHMArray[narrays]         (directly after the header)
+ *   slots[nslots]                    (starting at slotoffset)
+ * Every slot (of slotbytes) starts with an InovesaSHMSlot,
+ * followed by the data of all arrays (at their respective offset).
+ * All data is stored in native byte order.
+ *
+ * Results of the n'th published step (n = 1, 2, ...) go to slot (n-1)%nslots.
+ * Sequence numbers are accessed atomically:
+ * While writing slot data, the writer sets InovesaSHMSlot.sequence to 2n-1,
+ * afterwards to 2n, then InovesaSHMHeader.sequence to n.
+ * A reader takes n from the header, copies the data of the slot,
+ * and accepts them if the slot sequence was 2n before and after copying.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define INOVESA_SHM_MAGIC UINT64_C(0x415345564f4e49) /* "INOVESA" (little endian) */
+#define INOVESA_SHM_VERSION 1
+
+#define INOVESA_SHM_NAMELENGTH 32
+#define INOVESA_SHM_MAXRANK 4
+
+/* types of array elements */
+#define INOVESA_SHM_FLOAT32 1
+#define INOVESA_SHM_FLOAT64 2
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t narrays;
+    uint32_t nslots;
+    uint32_t reserved;
+    uint64_t slotoffset;
+    uint64_t slotbytes;
+
+    /* number of the last completely written step (0: none) */
+    uint64_t sequence;
+} InovesaSHMHeader;
+
+typedef struct {
+    char name[INOVESA_SHM_NAMELENGTH];
+    uint32_t type;
+    uint32_t rank;
+    uint32_t dims[INOVESA_SHM_MAXRANK];
+
+    /* relative to the start of a slot */
+    uint64_t offset;
+    uint64_t bytes;
+} InovesaSHMArray;
+
+typedef struct {
+    uint64_t sequence;
+
+    /* simulation step and time (in synchrotron periods) */
+    uint64_t step;
+    double time;
+    uint64_t reserved;
+} InovesaSHMSlot;
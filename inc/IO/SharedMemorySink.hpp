@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * This file is part of Inovesa (github.com/Inovesa/Inovesa).
+ * It's copyrighted by the contributors recorded
+ * in the version control history of the file.
+ */
+
+#pragma once
+
+#if INOVESA_USE_SHM == 1
+
+#include <string>
+#include <vector>
+
+#include "defines.hpp"
+#include "IO/SharedMemoryLayout.h"
+#include "PS/ElectricField.hpp"
+#include "PS/PhaseSpace.hpp"
+
+namespace vfps {
+
+/**
+ * @brief The SharedMemorySink class publishes results to other processes
+ *
+ * Bunch profile, energy profile, CSR intensity, and (optionally)
+ * the phase space are copied to a ring buffer in POSIX shared memory,
+ * the layout is described in IO/SharedMemoryLayout.h.
+ */
+class SharedMemorySink
+{
+public:
+    /**
+     * @brief SharedMemorySink
+     * @param name of the shared memory object (e.g. "/inovesa")
+     * @param nslots number of steps kept in the ring buffer
+     * @param phasespace also publish the phase space
+     *
+     * @throws std::runtime_error if the shared memory cannot be created
+     */
+    SharedMemorySink( const std::string name
+                    , const uint32_t nslots
+                    , const bool phasespace);
+
+    /**
+     * @brief ~SharedMemorySink removes the name of the shared memory object
+     *
+     * Readers that have already mapped it can still access the data.
+     */
+    ~SharedMemorySink() noexcept;
+
+    SharedMemorySink(const SharedMemorySink&) = delete;
+
+    SharedMemorySink& operator=(const SharedMemorySink&) = delete;
+
+    /**
+     * @brief publish copies results of a simulation step into the next slot
+     * @param ps phase space (with up-to-date projections)
+     * @param ef electric field (with up-to-date CSR intensity)
+     * @param step simulation step
+     * @param t time (in units of synchrotron periods)
+     */
+    void publish( const PhaseSpace& ps
+                , const ElectricField* ef
+                , const uint64_t step
+                , const timeaxis_t t);
+
+    inline bool withPhaseSpace() const
+        { return _phasespace; }
+
+private:
+    template <typename datatype>
+    void _addArray( const std::string& name
+                  , const std::vector<uint32_t>& dims);
+
+    const std::string _name;
+
+    const bool _phasespace;
+
+    std::vector<InovesaSHMArray> _arrays;
+
+    size_t _bytes;
+
+    InovesaSHMHeader* _header;
+
+    uint64_t _sequence;
+};
+
+} // namespace vfps
+
+#endif // INOVESA_USE_SHM
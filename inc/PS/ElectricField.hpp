@@ -139,6 +139,21 @@ public:
      */
     csrpower_t* updateCSR(const frequency_t cutoff);
 
+    /**
+     * @brief updateCSR reusing the form factor computed by another field
+     * @param source field that holds an up to date form factor,
+     *        typically the wake field after wakePotential()
+     * @param cutoff
+     * @return CSR spectrum (getNMax() points)
+     *
+     * When the padding differs, the squared form factor is resampled
+     * to the frequencies of this field. As the form factor of source
+     * includes all bunches, this falls back to updateCSR(cutoff)
+     * for multi bunch simulations.
+     */
+    csrpower_t* updateCSR(const ElectricField& source
+                         , const frequency_t cutoff);
+
     const std::vector<uint32_t> &getBuckets() const
         { return _bucket; }
 
@@ -161,9 +176,27 @@ public:
     inline meshaxis_t* getPaddedWakepotential() const
         { return _wakepotential_padded; }
 
+private:
+    /**
+     * @brief _copyBunchProfile copies the profile of bunch n to dst
+     *
+     * With OpenCL (and host FFT), only the profile is read from the device.
+     */
+    void _copyBunchProfile(const uint32_t n, integral_t* dst) const;
+
+public:
+
 
     #if INOVESA_USE_OPENCL == 1
     void syncCLMem(OCLH::clCopyDirection dir);
+
+    /**
+     * @brief downloadPadded starts copying the padded profile
+     *        and wake potential to the host (as used for output)
+     *
+     * Transfers are completed by OCLH::finishDownloads().
+     */
+    void downloadPadded();
     #endif // INOVESA_USE_OPENCL == 1
 
 public:
@@ -257,6 +290,13 @@ private: // wrappers for FFTW
                           fftwf_complex* out,
                           fft_direction direction);
 
+private:
+    /**
+     * @brief _spectrumFromFormFactor computes CSR spectrum and intensity
+     * @param n bunch, relies on an up to date _formfactor
+     */
+    void _spectrumFromFormFactor(const uint32_t n, const frequency_t cutoff);
+
 private:
     const uint32_t _nbunches;
 
@@ -142,6 +142,9 @@ public:
      * @param axis which axis? (0 -> x or 1 -> y)
      *
      * relies on an up-t date _projection[axis]
+     *
+     * With OpenCL, all four moments are reduced on the device
+     * and only the sums (and the bunch populations) are read back.
      */
     void average(const uint_fast8_t axis);
 
@@ -204,9 +207,10 @@ public:
      * @brief normalize
      * @return integral before normalization
      *
-     * @todo: Use OpenCL
-     *
      * normalize() does neither recompute the integral nor sets it to 1
+     *
+     * With OpenCL, the phase space is scaled on the device and
+     * the returned values are only updated by average().
      */
     inline const std::vector<integral_t>& integrateAndNormalize() {
         integrate();
@@ -302,6 +306,16 @@ public:
 
     #if INOVESA_USE_OPENCL == 1
     void syncCLMem(OCLH::clCopyDirection dir, cl::Event* evt = nullptr);
+
+    /**
+     * @brief download starts copying the projections to the host
+     * @param withdata also copy the phase space itself
+     * @param withprojections copy the projections
+     *
+     * Transfers are completed by OCLH::finishDownloads().
+     * (Moments and bunch populations are already read by average().)
+     */
+    void download(const bool withdata, const bool withprojections=true);
     #endif // INOVESA_USE_OPENCL
 
 protected:
@@ -476,24 +490,57 @@ public:
 
     cl::Buffer bunchpop_buf;
 
+    cl::Buffer projectionY_clbuf;
+
+    /**
+     * @brief ws_buf weights for Simpson integration (see _ws)
+     */
+    cl::Buffer  ws_buf;
+
 private:
     cl::Program _clProgProjX;
 
     cl::Kernel  _clKernProjX;
 
-    cl::Program _clProgIntegral;
+    /**
+     * @brief _clProgReduce holds kernels for integral, y projection,
+     *        moments and normalization
+     */
+    cl::Program _clProgReduce;
 
     cl::Kernel  _clKernIntegral;
 
+    cl::Kernel  _clKernProjY;
+
+    std::array<cl::Kernel,2> _clKernMoments;
+
+    cl::Kernel  _clKernNormalize;
+
+    /**
+     * @brief _clReduceSize work-group size (power of two) for reductions
+     */
+    size_t _clReduceSize;
+
+    /**
+     * @brief _axis_buf grid point coordinates (for moments)
+     */
+    std::array<cl::Buffer,2> _axis_buf;
+
+    /**
+     * @brief _momentsums_buf sums of projection*coordinate
+     *        and of projection*(coordinate-mean)^k (k=2..4)
+     */
+    std::array<cl::Buffer,2> _momentsums_buf;
+
+    cl::Buffer fillingset_buf;
+
     std::unique_ptr<cl::vector<cl::Event*>> xProjEvents;
 
     std::unique_ptr<cl::vector<cl::Event*>> integEvents;
 
     std::unique_ptr<cl::vector<cl::Event*>> syncPSEvents;
 
-    cl::Buffer  ws_buf;
-
-    static std::string cl_code_integral;
+    static std::string cl_code_reductions;
 
     static std::string cl_code_projection_x;
     #endif // INOVESA_USE_OPENCL == 1
@@ -9,8 +9,7 @@
 
 #include "SM/RFKickMap.hpp"
 
-#include <queue>
-#include <random>
+#include <cstdint>
 
 namespace vfps
 {
@@ -39,7 +38,6 @@ public:
                     , const meshaxis_t mulnoise
                     , const meshaxis_t modampl
                     , const double modtimeincrement
-                    , const uint32_t steps
                     , const InterpolationType it
                     , const bool interpol_clamp
                     , oclhptr_t oclh
@@ -61,7 +59,6 @@ public:
                     , const meshaxis_t amplspread
                     , const meshaxis_t modampl
                     , const double modtimeincrement
-                    , const uint32_t steps
                     , const InterpolationType it
                     , const bool interpol_clamp
                     , oclhptr_t oclh
@@ -72,10 +69,15 @@ public:
     /**
      * @brief apply updates RFKickMap before it is actually applied
      *
-     * @todo Add OpenCL code path
+     * With OpenCL, only phase and amplitude are passed to the device.
      */
     void apply() override;
 
+    /**
+     * @brief applyFused updates RFKickMap before both kicks are applied
+     */
+    void applyFused(KickMap& first) override;
+
     /**
      * @brief getPastModulation
      * @return modulations (phase,amplitude) since last call
@@ -91,23 +93,31 @@ private:
 
     const meshaxis_t _modtimedelta;
 
-    std::mt19937 _prng;
-    std::normal_distribution<meshaxis_t> _dist;
+    /**
+     * @brief _seed key of the counter-based random number generator
+     */
+    const uint64_t _seed;
 
-    std::queue<std::array<meshaxis_t,2>> _next_modulation;
+    /**
+     * @brief _step number of the next time step
+     */
+    uint64_t _step;
 
     std::vector<std::array<meshaxis_t,2>> _past_modulation;
 
     /**
-     * set up the KickMap with a (new) set of parameters
+     * @brief _normal normally distributed random number
+     * @param counter time step
+     * @param stream 0 for phase, 1 for amplitude noise
+     *
+     * The number only depends on _seed, counter and stream,
+     * so no generator state has to be kept (or copied to a device).
      */
-    std::queue<std::array<meshaxis_t,2>> __calcModulation(uint32_t steps);
+    meshaxis_t _normal(const uint64_t counter, const uint64_t stream) const;
 
 protected:
     /**
      * @brief update to current time step
-     *
-     * @todo For OpenCL, this should be done on device
      */
     void _calcKick();
 };
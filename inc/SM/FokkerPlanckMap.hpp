@@ -72,6 +72,14 @@ public:
      */
     void apply() override;
 
+    /**
+     * @brief applyAndUpdateXProjection apply and update projection of output
+     *
+     * With OpenCL, the projection is computed from the columns
+     * while they are still in local memory.
+     */
+    void applyAndUpdateXProjection();
+
     PhaseSpace::Position apply(PhaseSpace::Position pos) const override;
 
 private:
@@ -95,6 +103,22 @@ private:
      * it has to save the size of the actual mesh seperatly.
      */
     const meshindex_t _meshxsize;
+
+    #if INOVESA_USE_OPENCL == 1
+    /**
+     * @brief _clKernProjected applies the map and computes the projection
+     *
+     * Not initialized, if columns do not fit into local memory.
+     */
+    cl::Kernel _clKernProjected;
+
+    /**
+     * @brief _clProjectedLocal work-group size for _clKernProjected
+     */
+    cl::NDRange _clProjectedLocal;
+
+    OCLH::Access _clProjectedAccess;
+    #endif // INOVESA_USE_OPENCL
 };
 
 }
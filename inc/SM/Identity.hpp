@@ -42,7 +42,6 @@ public:
                                    , applySMEvents.get()
                                    # endif // INOVESA_ENABLE_CLPROFILING
                                    );
-            _oclh->enqueueBarrier();
             #if INOVESA_SYNC_CL == 1
             _out->syncCLMem(OCLH::clCopyDirection::dev2cpu);
             #endif // INOVESA_SYNC_CL
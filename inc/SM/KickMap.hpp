@@ -47,8 +47,26 @@ public:
 
     PhaseSpace::Position apply(PhaseSpace::Position pos) const override;
 
+    /**
+     * @brief applyFused applies first and then this KickMap in one pass
+     * @param first energy kick to apply before this one
+     *
+     * With OpenCL, every column is kept in local memory between the kicks,
+     * so the output of first is neither written nor read. (It is not
+     * updated at all.) Otherwise (also for several bunches),
+     * first.apply() and apply() are called.
+     */
+    virtual void applyFused(KickMap& first);
+
     #if INOVESA_USE_OPENCL == 1
     void syncCLMem(OCLH::clCopyDirection dir);
+
+    /**
+     * @brief download starts copying the offset to the host
+     *
+     * The transfer is completed by OCLH::finishDownloads().
+     */
+    void download();
     #endif // INOVESA_USE_OPENCL
 
 protected:
@@ -59,6 +77,36 @@ protected:
 
     #if INOVESA_USE_OPENCL == 1
     cl::Buffer _offset_clbuf;
+
+    /**
+     * @brief _clGlobal global work size used for applySM
+     */
+    cl::NDRange _clGlobal;
+
+    /**
+     * @brief _clLocal work-group size used for applySM
+     */
+    cl::NDRange _clLocal;
+
+    /**
+     * @brief tile size (along x and y) of the tiled x-kick kernel
+     *
+     * Every work-group shifts _tilesize x _tilesize mesh points.
+     */
+    static constexpr cl_int _tilesize = 16;
+
+    /**
+     * @brief _clKernFused applies two energy kicks (see applyFused)
+     *
+     * Not initialized, if there are several bunches
+     * or if columns do not fit into local memory.
+     */
+    cl::Kernel _clKernFused;
+
+    /**
+     * @brief _clFusedLocal work-group size for _clKernFused
+     */
+    cl::NDRange _clFusedLocal;
     #endif // INOVESA_USE_OPENCL
 
     /**
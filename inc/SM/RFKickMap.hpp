@@ -41,6 +41,17 @@ public:
 
     ~RFKickMap() noexcept override;
 
+public:
+    using KickMap::apply;
+
+    /**
+     * @brief apply to particle
+     *
+     * With OpenCL, the offsets are only known on the device,
+     * so the kick is computed for the particle's position.
+     */
+    PhaseSpace::Position apply(PhaseSpace::Position pos) const override;
+
 protected:
     const bool _linear;
 
@@ -58,9 +69,53 @@ protected:
 
     const timeaxis_t _bl2phase;
 
+    /**
+     * @brief _phase RF phase used for the current kick
+     */
+    meshaxis_t _phase;
+
+    /**
+     * @brief _ampl relative RF amplitude used for the current kick
+     */
+    meshaxis_t _ampl;
+
+    #if INOVESA_USE_OPENCL == 1
+    /**
+     * @brief _rfphase_clbuf RF phase of grid points (without offset)
+     */
+    cl::Buffer _rfphase_clbuf;
+
+    cl::Program _clProgKick;
+
+    /**
+     * @brief _clKernKick computes _offset_clbuf for given phase and amplitude
+     */
+    cl::Kernel _clKernKick;
+
+    OCLH::Access _clKickAccess;
+    #endif // INOVESA_USE_OPENCL
+
 protected:
+    /**
+     * @brief _calcKick updates the offset
+     *
+     * With OpenCL, the offset is computed on the device,
+     * only phase and amplitude are passed as kernel arguments.
+     */
     virtual void _calcKick( const meshaxis_t phase=0
                           , const meshaxis_t ampl=1);
+
+    /**
+     * @brief _kick offset at grid point x
+     */
+    meshaxis_t _kick( const meshindex_t x
+                    , const meshaxis_t phase
+                    , const meshaxis_t ampl) const;
+
+private:
+    #if INOVESA_USE_OPENCL == 1
+    void _prepareCLKick();
+    #endif // INOVESA_USE_OPENCL
 };
 
 } // namespace vfps
@@ -130,6 +130,11 @@ protected:
      */
     cl::Kernel applySM;
 
+    /**
+     * @brief _clAccess buffers read and written by applySM
+     */
+    OCLH::Access _clAccess;
+
     #if INOVESA_ENABLE_CLPROFILING == 1
     std::unique_ptr<cl::vector<cl::Event*>> applySMEvents;
 
@@ -49,10 +49,24 @@ public:
     /**
      * @brief update overrides WakeKickMap
      *
-     * @todo currently uses phasespace in CPU Ram
+     * Convolves the current bunch profile(s) with the wake function.
+     * Depending on the mesh size, this is done directly or using FFT,
+     * whichever was found to be faster during construction.
+     * With OpenCL, the convolution is done on the device,
+     * based on the x projection only (one work-item per x and bunch).
      */
     void update() override;
 
+    /**
+     * @brief The ConvolutionMethod enum lists ways to apply the wake
+     */
+    enum class ConvolutionMethod : uint_fast8_t {
+        direct, fft, opencl
+    };
+
+    inline ConvolutionMethod getConvolutionMethod() const
+        { return _method; }
+
 private:
     /**
      * @brief _wakeFromFile reads in a file and scales wake to internal units
@@ -60,6 +74,29 @@ private:
      */
     void _wakeFromFile(const std::string fname, const double scaling);
 
+    /**
+     * @brief _prepareConvolution precomputes the wake spectrum
+     *        and chooses the convolution method
+     *
+     * has to be called after the wake function is known
+     */
+    void _prepareConvolution();
+
+    /**
+     * @brief _convolveDirect straight forward O(nx^2) convolution
+     *
+     * The loop is ordered to be a sequence of axpy operations,
+     * so that the compiler can vectorize the inner loop.
+     */
+    void _convolveDirect(const projection_t* density, const meshaxis_t scale
+                        , meshaxis_t* result);
+
+    /**
+     * @brief _convolveFFT convolution using the precomputed wake spectrum
+     */
+    void _convolveFFT(const projection_t* density, const meshaxis_t scale
+                     , meshaxis_t* result);
+
 
 private:
     /**
@@ -91,6 +128,38 @@ private:
     meshaxis_t* const _wakefunction;
 
     const size_t _wakesize;
+
+    ConvolutionMethod _method;
+
+    /**
+     * @brief _density_padded bunch profile, zero padded to _wakesize
+     *
+     * As the wake function has 2*xsize points, a cyclic convolution
+     * of that length does not suffer from aliasing for the xsize points
+     * that are actually used.
+     */
+    float* _density_padded;
+
+    fftwf_complex* _density_fft;
+
+    /**
+     * @brief _wakespectrum FFT of the wake function, includes 1/_wakesize
+     */
+    fftwf_complex* _wakespectrum;
+
+    float* _convolution;
+
+    fftwf_plan _fft_density;
+
+    fftwf_plan _fft_convolution;
+
+    #if INOVESA_USE_OPENCL == 1
+    cl::Buffer _wakefunction_clbuf;
+
+    cl::Program _clProgWakeConv;
+
+    cl::Kernel _clKernWakeConv;
+    #endif // INOVESA_USE_OPENCL
 };
 
 } // namespace vfps
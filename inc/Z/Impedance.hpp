@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "CL/OpenCLHandler.hpp"
@@ -64,8 +66,21 @@ public:
      * @brief Impedance
      * @param name of datafile in the format "n Re(Z) Im(Z)",
      *        where n=f/f_rev is the revolution harmonic
+     * @param nfreqs number of frequencies (including n<0)
+     * @param f_rev revolution frequency
+     * @param f_max
+     *
+     * The data is linearly interpolated to the frequencies used here,
+     * so the file does not have to match nfreqs and f_max.
+     * Lines not starting with three numbers (e.g. headers) are ignored.
+     * Outside of the range given in the file, the impedance is set to zero.
      */
-    Impedance( std::string datafile, double f_max, oclhptr_t oclh = nullptr);
+    Impedance( std::string datafile
+             , const size_t nfreqs
+             , const double f_rev
+             , const double f_max
+             , oclhptr_t oclh = nullptr
+             );
 
     inline const impedance_t* data() const
         { return _data.data(); }
@@ -117,7 +132,29 @@ protected:
     oclhptr_t _oclh;
 
 private:
-    static std::vector<impedance_t> readData(std::string fname);
+    /**
+     * @brief readData reads impedance from file and resamples it
+     * @param fname see Impedance( std::string datafile, ...)
+     * @param nfreqs
+     * @param delta step size of revolution harmonics to sample at
+     *
+     * Text files are parsed once, afterwards a binary copy
+     * (fname+".inovesa-cache") is memory mapped instead.
+     */
+    static std::vector<impedance_t> readData( std::string fname
+                                            , const size_t nfreqs
+                                            , const double delta);
+
+protected:
+    /**
+     * @brief forEachFrequency calls f(i) for all first <= i < last
+     *
+     * Frequencies are distributed interleaved over all hardware threads,
+     * so that models where the cost grows with frequency stay balanced.
+     * f must only touch data belonging to its own frequency.
+     */
+    template <typename Function>
+    static void forEachFrequency(size_t first, size_t last, Function f);
 
 public:
     /**
@@ -132,8 +169,44 @@ public:
      * see http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
      */
     static uint64_t upper_power_of_two(uint64_t v);
+
+    /**
+     * @brief upper_smooth_number
+     * @param v
+     * @return smallest number 2^a*3^b*5^c that is not smaller than v
+     *
+     * FFTW (and clFFT) are efficient for such sizes, so this can be used
+     * instead of upper_power_of_two to save memory and computing time.
+     */
+    static uint64_t upper_smooth_number(uint64_t v);
 };
 
+template <typename Function>
+void Impedance::forEachFrequency(size_t first, size_t last, Function f)
+{
+    if (last <= first) {
+        return;
+    }
+    const size_t nthreads = std::min<size_t>(
+                std::max(std::thread::hardware_concurrency(),1U),
+                last-first);
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads-1);
+    for (size_t t=1; t<nthreads; t++) {
+        threads.emplace_back([=]() {
+            for (size_t i=first+t; i<last; i+=nthreads) {
+                f(i);
+            }
+        });
+    }
+    for (size_t i=first; i<last; i+=nthreads) {
+        f(i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 inline Impedance operator+(Impedance& lhs, const Impedance& rhs)
 {
     lhs += rhs;
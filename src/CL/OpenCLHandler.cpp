@@ -9,6 +9,14 @@
 
 #include "CL/OpenCLHandler.hpp"
 #include "IO/Display.hpp"
+#include "IO/FSPath.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #ifdef __linux__
 #include <GL/glx.h>
 #endif
@@ -21,8 +29,11 @@
 #include <CL/cl_gl.h>
 #endif
 
-OCLH::OCLH( uint32_t device, bool glsharing)
+OCLH::OCLH( uint32_t device, bool glsharing, bool outoforder, bool retune
+          , uint32_t ndevices)
   : ogl_sharing(glsharing)
+  , _outoforder(outoforder)
+  , _retune(retune)
 {
     cl::vector<cl::Platform> platforms;
     cl::Platform::get(&platforms);
@@ -54,14 +65,91 @@ OCLH::OCLH( uint32_t device, bool glsharing)
         }
     }
 
+    if (ndevices > 1) {
+        cl::vector<cl::Device> used;
+        const auto partitions
+                = _device.getInfo<CL_DEVICE_PARTITION_PROPERTIES>();
+        const auto cus = _device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        if (cus >= ndevices
+                && std::find( partitions.begin(),partitions.end()
+                            , CL_DEVICE_PARTITION_EQUALLY)
+                   != partitions.end()) {
+            const cl_device_partition_property props[] = {
+                CL_DEVICE_PARTITION_EQUALLY,
+                static_cast<cl_device_partition_property>(cus/ndevices),
+                0 };
+            try {
+                _device.createSubDevices(props,&used);
+            } catch (cl::Error&) {
+                used.clear();
+            }
+        }
+        const bool subdevices = (used.size() >= ndevices);
+        if (!subdevices) {
+            used.clear();
+            for (const auto& d : _devices) {
+                if (!used.empty() || d() == _device()) {
+                    used.push_back(d);
+                }
+            }
+        }
+        if (used.size() > ndevices) {
+            used.resize(ndevices);
+        }
+        if (used.size() > 1) {
+            cl::vector<cl::Device> devices(used);
+            if (subdevices) {
+                // all other kernels still use the undivided device
+                devices.insert(devices.begin(),_device);
+            }
+            // sub-devices are not part of the original context
+            ogl_sharing = false;
+            context = cl::Context(devices, properties(_platform,false).data());
+            _devices = devices;
+            _blockdevices = used;
+        }
+    }
+    _usedDevices = {_device};
+    for (const auto& d : _blockdevices) {
+        if (d() != _device()) {
+            _usedDevices.push_back(d);
+        }
+    }
+
+    cl_command_queue_properties queueprops = 0;
     #if INOVESA_ENABLE_CLPROFILING == 1
-    queue = cl::CommandQueue(context,_device,CL_QUEUE_PROFILING_ENABLE);
-    #else
-    queue = cl::CommandQueue(context,_device);
+    queueprops |= CL_QUEUE_PROFILING_ENABLE;
     #endif // INOVESA_ENABLE_CLPROFILING
+    // every block queue gets one kernel (with explicit dependencies) at a time
+    const cl_command_queue_properties blockprops = queueprops;
+    if (_outoforder) {
+        if (_device.getInfo<CL_DEVICE_QUEUE_PROPERTIES>()
+                & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+            queueprops |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        } else {
+            vfps::Display::printText("Device does not support out-of-order"
+                                     " execution, will use in-order queue.");
+            _outoforder = false;
+        }
+    }
+    queue = cl::CommandQueue(context,_device,queueprops);
+    _blockalign = 1;
+    for (const auto& d : _blockdevices) {
+        if (d() == _device()) {
+            _blockqueues.push_back(queue);
+        } else {
+            _blockqueues.emplace_back(context,d,blockprops);
+        }
+        // sub-buffers have to be aligned for every device
+        _blockalign = std::max<size_t>( _blockalign
+                                      , d.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>()/8);
+    }
 
     devicetype = _device.getInfo<CL_DEVICE_TYPE>();
 
+    _deviceid = deviceId(_device);
+    loadWorkSizes();
+
     #if INOVESA_USE_OPENGL == 1
     // cl_VENDOR_gl_sharing is present, when string contains the substring
     if (_device.getInfo<CL_DEVICE_EXTENSIONS>().find("_gl_sharing")
@@ -90,35 +178,443 @@ OCLH::OCLH( uint32_t device, bool glsharing)
         vfps::Display::printText("Sharing between OpenCL "
                                  "and OpenGL is active.");
     }
+    if (_blockdevices.size() > 1) {
+        vfps::Display::printText("Column blocks are distributed over "
+                                 + std::to_string(_blockdevices.size())
+                                 + " (sub-)devices.");
+    }
 }
 
 cl::Program OCLH::prepareCLProg(std::string code)
 {
     code = datatype_aliases()+custom_datatypes+code;
-    cl::vector<std::string> codevec;
-    codevec.push_back(code);
-    cl::Program::Sources source(codevec);
-    cl::Program p(context, source);
-    try {
-        // empty for compatibility reasons.
-        std::string OCLBuildOpts("");
-
-        p.build(_devices,OCLBuildOpts.c_str());
-    } catch (cl::Error &e) {
-        std::cerr << e.what() << std::endl;
-        std::cout << "===== OpenCL Code =====\n"
-                                << code << std::endl;
-        std::cout << "===== OpenCL Build Log =====\n"
-                  << p.getBuildInfo<CL_PROGRAM_BUILD_LOG>(_device)
-                  << std::endl;
-        #if DEBUG == 1
-        throw e;
-        #endif
+
+    auto known = _programs.find(code);
+    if (known != _programs.end()) {
+        return known->second;
+    }
+
+    // empty for compatibility reasons.
+    std::string OCLBuildOpts("");
+
+    // everything that has influence on the resulting binary (per device)
+    std::vector<std::string> ids;
+    for (const auto& d : _usedDevices) {
+        ids.push_back( deviceId(d)
+                     + '|' + OCLBuildOpts
+                     + '|' + vfps::FSPath::hexhash(code));
+    }
+
+    cl::Program p;
+    if (!loadCLProgBinary(ids,OCLBuildOpts,p)) {
+        cl::vector<std::string> codevec;
+        codevec.push_back(code);
+        cl::Program::Sources source(codevec);
+        p = cl::Program(context, source);
+        try {
+            p.build(_usedDevices,OCLBuildOpts.c_str());
+            saveCLProgBinary(ids,p);
+        } catch (cl::Error &e) {
+            std::cerr << e.what() << std::endl;
+            std::cout << "===== OpenCL Code =====\n"
+                                    << code << std::endl;
+            std::cout << "===== OpenCL Build Log =====\n"
+                      << p.getBuildInfo<CL_PROGRAM_BUILD_LOG>(_device)
+                      << std::endl;
+            #if DEBUG == 1
+            throw e;
+            #endif
+            return p;
+        }
     }
+    _programs.emplace(code,p);
 
 return p;
 }
 
+/**
+ * @brief OCLH::loadCLProgBinary
+ * @param ids identify the binary for each of _usedDevices
+ * @return true if matching binaries were found and built successfully
+ *
+ * The first line of a cache file holds the id, to detect hash collisions.
+ */
+bool OCLH::loadCLProgBinary( const std::vector<std::string>& ids
+                           , const std::string& buildopts
+                           , cl::Program& p)
+{
+    cl::Program::Binaries binaries;
+    for (const auto& id : ids) {
+        std::ifstream is(programFile(id), std::ios::binary);
+        std::string storedid;
+        if (!std::getline(is,storedid) || storedid != id) {
+            return false;
+        }
+        binaries.emplace_back(std::istreambuf_iterator<char>(is),
+                              std::istreambuf_iterator<char>());
+        if (binaries.back().empty()) {
+            return false;
+        }
+    }
+    try {
+        p = cl::Program(context,_usedDevices,binaries);
+        p.build(_usedDevices,buildopts.c_str());
+    } catch (cl::Error&) {
+        // e.g. the driver does not accept its old binaries anymore
+        return false;
+    }
+    return true;
+}
+
+void OCLH::saveCLProgBinary( const std::vector<std::string>& ids
+                           , const cl::Program& p) const
+{
+    const auto devices = p.getInfo<CL_PROGRAM_DEVICES>();
+    const auto binaries = p.getInfo<CL_PROGRAM_BINARIES>();
+    for (size_t u=0; u<_usedDevices.size(); u++) {
+        // e.g. sub-devices share the binary of their parent device
+        if (std::find(ids.begin(),ids.begin()+u,ids[u]) != ids.begin()+u) {
+            continue;
+        }
+        for (size_t d=0; d<devices.size() && d<binaries.size(); d++) {
+            if (devices[d]() != _usedDevices[u]() || binaries[d].empty()) {
+                continue;
+            }
+            vfps::FSPath::writeAtomically(programFile(ids[u])
+                                         ,[&](std::ostream& os) {
+                os << ids[u] << '\n';
+                os.write(reinterpret_cast<const char*>(binaries[d].data()),
+                         binaries[d].size());
+            });
+            break;
+        }
+    }
+}
+
+std::string OCLH::programFile(const std::string& id)
+{
+    return vfps::FSPath(vfps::FSPath::datapath())
+            .append("clprograms/"+vfps::FSPath::hexhash(id)+".bin").str();
+}
+
+std::string OCLH::deviceId(const cl::Device& device) const
+{
+    return _platform.getInfo<CL_PLATFORM_NAME>()
+         + '|' + device.getInfo<CL_DEVICE_NAME>()
+         + '|' + device.getInfo<CL_DEVICE_VERSION>()
+         + '|' + device.getInfo<CL_DRIVER_VERSION>();
+}
+
+cl::NDRange OCLH::localSize( const Access& access
+                           , const cl::Kernel& kernel
+                           , const cl::NDRange& global)
+{
+    auto known = _localsizes.find(kernel());
+    if (known != _localsizes.end()
+            && known->second.global.dimensions() == global.dimensions()
+            && std::equal(global.get(),global.get()+global.dimensions(),
+                          known->second.global.get())) {
+        return known->second.local;
+    }
+
+    std::stringstream key;
+    key << kernel.getInfo<CL_KERNEL_FUNCTION_NAME>()
+        << ' ' << global.dimensions();
+    for (cl::size_type d=0; d<3; d++) {
+        key << ' ' << global.get()[d];
+    }
+
+    cl::NDRange local = cl::NullRange;
+    auto stored = _worksizes.find(key.str());
+    if (stored != _worksizes.end() && !_retune) {
+        local = stored->second;
+    } else {
+        bool inplace = false;
+        for (const auto& r : access.read) {
+            for (const auto& w : access.write) {
+                inplace |= (r() == w());
+            }
+        }
+        if (!inplace) {
+            local = benchmarkLocalSize(kernel,global);
+            _worksizes[key.str()] = local;
+            saveWorkSizes();
+        }
+    }
+    _localsizes[kernel()] = LocalSize{global,local};
+    return local;
+}
+
+/**
+ * @brief OCLH::benchmarkLocalSize
+ *
+ * Candidates are powers of two that divide the global size
+ * (as required by OpenCL 1.x) and the choice of the driver.
+ */
+cl::NDRange OCLH::benchmarkLocalSize( const cl::Kernel& kernel
+                                    , const cl::NDRange& global)
+{
+    const size_t maxwgs = maxWorkGroupSize(kernel);
+    std::vector<cl::NDRange> candidates{cl::NullRange};
+    if (global.dimensions() == 1) {
+        for (size_t l=8; l<=maxwgs; l*=2) {
+            if (global.get()[0]%l == 0) {
+                candidates.emplace_back(l);
+            }
+        }
+    } else if (global.dimensions() == 2) {
+        for (size_t l0=1; l0<=maxwgs; l0*=2) {
+            for (size_t l1=1; l0*l1<=maxwgs; l1*=2) {
+                if (l0*l1 >= 8 && global.get()[0]%l0 == 0
+                               && global.get()[1]%l1 == 0) {
+                    candidates.emplace_back(l0,l1);
+                }
+            }
+        }
+    }
+
+    // wait for everything the kernel might depend on
+    finish();
+
+    const std::string name = kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+    cl::NDRange best = cl::NullRange;
+    auto besttime = std::chrono::steady_clock::duration::max();
+    for (const auto& local : candidates) {
+        try {
+            // first launch is not timed, it might include setup costs
+            queue.enqueueNDRangeKernel(kernel,cl::NullRange,global,local);
+            queue.finish();
+            const auto start = std::chrono::steady_clock::now();
+            for (uint32_t i=0; i<_tuningreps; i++) {
+                queue.enqueueNDRangeKernel(kernel,cl::NullRange,global,local);
+            }
+            queue.finish();
+            const auto time = std::chrono::steady_clock::now()-start;
+            if (time < besttime) {
+                besttime = time;
+                best = local;
+            }
+        } catch (cl::Error&) {
+            // size not usable for this kernel (e.g. too few resources)
+        }
+    }
+
+    std::stringstream msg;
+    msg << "Tuned work-group size for \"" << name << "\": ";
+    if (best.dimensions() == 0) {
+        msg << "driver default";
+    } else {
+        msg << best.get()[0];
+        for (cl::size_type d=1; d<best.dimensions(); d++) {
+            msg << 'x' << best.get()[d];
+        }
+    }
+    vfps::Display::printText(msg.str());
+
+    return best;
+}
+
+std::string OCLH::workSizesFile() const
+{
+    return vfps::FSPath(vfps::FSPath::datapath())
+            .append("clprograms/worksizes-"
+                    +vfps::FSPath::hexhash(_deviceid+'|'+datatype_aliases())
+                    +".txt").str();
+}
+
+/**
+ * @brief OCLH::loadWorkSizes
+ *
+ * The first line holds the device id, every following line
+ * kernel name, dimensions, global size (3 values), and local size
+ * (3 values, all zero for the driver's choice).
+ */
+void OCLH::loadWorkSizes()
+{
+    std::ifstream is(workSizesFile());
+    std::string storedid;
+    if (!std::getline(is,storedid) || storedid != _deviceid) {
+        return;
+    }
+    std::string name;
+    cl::size_type dims;
+    std::array<cl::size_type,3> g;
+    std::array<cl::size_type,3> l;
+    while (is >> name >> dims >> g[0] >> g[1] >> g[2] >> l[0] >> l[1] >> l[2]) {
+        std::stringstream key;
+        key << name << ' ' << dims << ' ' << g[0] << ' ' << g[1] << ' ' << g[2];
+        if (l[0] == 0) {
+            _worksizes[key.str()] = cl::NullRange;
+        } else if (dims == 1) {
+            _worksizes[key.str()] = cl::NDRange(l[0]);
+        } else if (dims == 2) {
+            _worksizes[key.str()] = cl::NDRange(l[0],l[1]);
+        } else {
+            _worksizes[key.str()] = cl::NDRange(l[0],l[1],l[2]);
+        }
+    }
+}
+
+void OCLH::saveWorkSizes() const
+{
+    vfps::FSPath::writeAtomically(workSizesFile(),[&](std::ostream& os) {
+        os << _deviceid << '\n';
+        for (const auto& ws : _worksizes) {
+            os << ws.first;
+            for (cl::size_type d=0; d<3; d++) {
+                os << ' ' << (d < ws.second.dimensions()
+                              ? ws.second.get()[d] : 0);
+            }
+            os << '\n';
+        }
+    });
+}
+
+void OCLH::enqueueColumnBlocks( const Access& access
+                               , cl::Kernel& kernel
+                               , const std::vector<ColumnArg>& columns
+                               , const size_t ncols
+                               , const size_t local
+                               #if INOVESA_ENABLE_CLPROFILING == 1
+                               , cl::vector<cl::Event*>* timings
+                               #endif // INOVESA_ENABLE_CLPROFILING
+                               )
+{
+    /* Sub-buffers have to start at multiples of the base address alignment,
+     * so blocks are made of multiples of granularity columns.
+     */
+    size_t granularity = 1;
+    for (const auto& arg : columns) {
+        size_t g = 1;
+        while ((g*arg.colbytes)%_blockalign != 0) {
+            g++;
+        }
+        // least common multiple
+        size_t lcm = granularity;
+        while (lcm%g != 0) {
+            lcm += granularity;
+        }
+        granularity = lcm;
+    }
+    const size_t nblocks = std::min( devices()
+                                   , std::max(ncols/granularity,size_t(1)));
+    if (nblocks < 2) {
+        for (const auto& arg : columns) {
+            kernel.setArg(arg.index,arg.buffer);
+        }
+        enqueueNDRangeKernel( access,kernel,cl::NullRange
+                            , cl::NDRange(ncols*local),cl::NDRange(local)
+                            #if INOVESA_ENABLE_CLPROFILING == 1
+                            , nullptr, nullptr, timings
+                            #endif // INOVESA_ENABLE_CLPROFILING
+                            );
+        return;
+    }
+
+    // commands on queue that the blocks have to wait for
+    cl::vector<cl::Event> waitlist;
+    if (_outoforder) {
+        waitlist = _waitlist(access,nullptr);
+    } else {
+        cl::Event marker;
+        queue.enqueueMarkerWithWaitList(nullptr,&marker);
+        waitlist.push_back(marker);
+    }
+
+    const size_t blocksize = (ncols/nblocks)/granularity*granularity;
+    cl::vector<cl::Event> blockevents(nblocks);
+    for (size_t b=0; b<nblocks; b++) {
+        const size_t first = b*blocksize;
+        const size_t cols = (b+1 < nblocks)? blocksize : ncols-first;
+        for (const auto& arg : columns) {
+            const auto key = std::make_tuple( arg.buffer()
+                                            , first*arg.colbytes
+                                            , cols*arg.colbytes);
+            auto sub = _subbuffers.find(key);
+            if (sub == _subbuffers.end()) {
+                cl_buffer_region region{first*arg.colbytes,cols*arg.colbytes};
+                cl::Buffer parent = arg.buffer;
+                sub = _subbuffers.emplace(key, parent.createSubBuffer(
+                                              CL_MEM_READ_WRITE,
+                                              CL_BUFFER_CREATE_TYPE_REGION,
+                                              &region)).first;
+            }
+            kernel.setArg(arg.index,sub->second);
+        }
+        cl::CommandQueue& q = _blockqueues[b];
+        q.enqueueNDRangeKernel( kernel,cl::NullRange
+                              , cl::NDRange(cols*local),cl::NDRange(local)
+                              , &waitlist,&blockevents[b]);
+        #if INOVESA_ENABLE_CLPROFILING == 1
+        cl::Event* event = new cl::Event(blockevents[b]);
+        if (timings == nullptr) {
+            timingsExecute.push_back(event);
+        } else {
+            timings->push_back(event);
+        }
+        #endif // INOVESA_ENABLE_CLPROFILING
+        q.flush();
+    }
+
+    // later commands on queue wait for all blocks
+    if (_outoforder) {
+        cl::Event marker;
+        queue.enqueueMarkerWithWaitList(&blockevents,&marker);
+        _record(access,marker);
+    } else {
+        queue.enqueueBarrierWithWaitList(&blockevents);
+    }
+}
+
+cl::vector<cl::Event> OCLH::_waitlist( const Access& access
+                                     , const cl::vector<cl::Event>* events)
+{
+    cl::vector<cl::Event> rv;
+    if (events != nullptr) {
+        rv = *events;
+    }
+    // read after write
+    for (const auto& buf : access.read) {
+        auto state = _bufferstate.find(buf());
+        if (state != _bufferstate.end() && state->second.write() != nullptr) {
+            rv.push_back(state->second.write);
+        }
+    }
+    // write after write and write after read
+    for (const auto& buf : access.write) {
+        auto state = _bufferstate.find(buf());
+        if (state != _bufferstate.end()) {
+            if (state->second.write() != nullptr) {
+                rv.push_back(state->second.write);
+            }
+            rv.insert(rv.end(),state->second.reads.begin(),
+                      state->second.reads.end());
+        }
+    }
+    return rv;
+}
+
+void OCLH::_record(const Access& access, const cl::Event& event)
+{
+    for (const auto& buf : access.read) {
+        auto& reads = _bufferstate[buf()].reads;
+        reads.push_back(event);
+        /* Buffers that are only read (e.g. the impedance) would collect
+         * events forever, so they are merged using a marker.
+         */
+        if (reads.size() > 16) {
+            cl::Event marker;
+            queue.enqueueMarkerWithWaitList(&reads,&marker);
+            reads = {marker};
+        }
+    }
+    for (const auto& buf : access.write) {
+        auto& state = _bufferstate[buf()];
+        state.write = event;
+        state.reads.clear();
+    }
+}
+
 #if INOVESA_ENABLE_CLPROFILING == 1
 void OCLH::saveProfilingInfo(std::string fname)
 {
@@ -162,8 +658,81 @@ void OCLH::saveTimings(cl::vector<cl::Event*>* evts, std::string name)
 }
 #endif // INOVESA_ENABLE_CLPROFILING
 
+OCLH::Staging& OCLH::_stagingFor(const cl::Buffer& buffer, size_t size)
+{
+    Staging& staging = _staging[buffer()];
+    // data of an earlier download must not be overwritten
+    for (const auto& download : _downloads) {
+        if (download.src == staging.host) {
+            finishDownloads();
+            break;
+        }
+    }
+    if (staging.size < size) {
+        if (staging.size > 0) {
+            queue.enqueueUnmapMemObject(staging.pinned,staging.host);
+        }
+        staging.pinned = cl::Buffer( context
+                                   , CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR
+                                   , size);
+        staging.host = queue.enqueueMapBuffer( staging.pinned,CL_TRUE
+                                             , CL_MAP_READ | CL_MAP_WRITE
+                                             , 0,size);
+        staging.size = size;
+        staging.pending = cl::Event();
+    } else if (staging.pending() != nullptr) {
+        staging.pending.wait();
+    }
+    return staging;
+}
+
+void OCLH::enqueueDownload(const cl::Buffer& buffer, size_t size, void* dst)
+{
+    Staging& staging = _stagingFor(buffer,size);
+    #if INOVESA_ENABLE_CLPROFILING == 1
+    cl::Event* event = new cl::Event();
+    #else
+    cl::Event localevent;
+    cl::Event* event = &localevent;
+    #endif // INOVESA_ENABLE_CLPROFILING
+    enqueueReadBuffer(buffer,CL_FALSE,0,size,staging.host,nullptr,event);
+    staging.pending = *event;
+    _downloads.push_back({*event,staging.host,dst,size});
+}
+
+void OCLH::finishDownloads()
+{
+    if (_downloads.empty()) {
+        return;
+    }
+    queue.flush();
+    for (auto& download : _downloads) {
+        download.event.wait();
+        std::memcpy(download.dst,download.src,download.size);
+    }
+    _downloads.clear();
+}
+
+void OCLH::enqueueUpload(const cl::Buffer& buffer, size_t size, const void* src)
+{
+    Staging& staging = _stagingFor(buffer,size);
+    std::memcpy(staging.host,src,size);
+    #if INOVESA_ENABLE_CLPROFILING == 1
+    cl::Event* event = new cl::Event();
+    #else
+    cl::Event localevent;
+    cl::Event* event = &localevent;
+    #endif // INOVESA_ENABLE_CLPROFILING
+    enqueueWriteBuffer(buffer,CL_FALSE,0,size,staging.host,nullptr,event);
+    staging.pending = *event;
+}
+
 OCLH::~OCLH()
 {
+    finishDownloads();
+    for (auto& staging : _staging) {
+        queue.enqueueUnmapMemObject(staging.second.pinned,staging.second.host);
+    }
     #if INOVESA_ENABLE_CLPROFILING == 1
     saveProfilingInfo("inovesa-timings.txt");
     #else
@@ -201,7 +201,7 @@ GLFWwindow* vfps::Display::openWindow(uint_fast8_t glversion)
 
 std::chrono::system_clock::time_point vfps::Display::start_time;
 
-volatile bool vfps::Display::abort(false);
+std::atomic<bool> vfps::Display::abort(false);
 
 std::chrono::system_clock::time_point vfps::Display::_lastmessage;
 
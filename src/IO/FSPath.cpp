@@ -7,6 +7,12 @@
 
 #include "IO/FSPath.hpp"
 
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
 vfps::FSPath::FSPath(std::string path)
   : _path(expand_user(path))
 {
@@ -72,3 +78,38 @@ std::string vfps::FSPath::datapath()
     return rval;
 }
 
+
+std::string vfps::FSPath::hexhash(const std::string& str)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    std::stringstream rv;
+    rv << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return rv.str();
+}
+
+bool vfps::FSPath::writeAtomically( const std::string& path
+                                  , std::function<void(std::ostream&)> write)
+{
+    try {
+        fs::path tmppath(path);
+        tmppath += fs::unique_path(".%%%%-%%%%-%%%%.tmp");
+        {
+            std::ofstream os(tmppath.string(), std::ios::binary);
+            write(os);
+            if (!os.good()) {
+                os.close();
+                fs::remove(tmppath);
+                return false;
+            }
+        }
+        fs::rename(tmppath,path);
+    } catch (const fs::filesystem_error& e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -8,8 +8,44 @@
 #if INOVESA_USE_HDF5 == 1
 #include "IO/HDF5File.hpp"
 
+#include "IO/Display.hpp"
 #include "MessageStrings.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#if INOVESA_USE_ZLIB == 1
+#include <zlib.h>
+#endif // INOVESA_USE_ZLIB
+
+namespace {
+
+/* Differences of snapshots are bitwise, so that they are exact.
+ * (Similar values share sign, exponent, and leading mantissa bits,
+ * so the differences still compress well.)
+ */
+vfps::meshdata_t bitwiseXor(const vfps::meshdata_t a, const vfps::meshdata_t b)
+{
+    typedef std::conditional<sizeof(vfps::meshdata_t) == sizeof(uint64_t)
+                            , uint64_t, uint32_t>::type bits_t;
+    static_assert(sizeof(bits_t) == sizeof(vfps::meshdata_t),
+                  "meshdata_t has to be a 32 or 64 bit type");
+    bits_t ba, bb;
+    std::memcpy(&ba,&a,sizeof(a));
+    std::memcpy(&bb,&b,sizeof(b));
+    ba ^= bb;
+    vfps::meshdata_t rv;
+    std::memcpy(&rv,&ba,sizeof(rv));
+    return rv;
+}
+
+} // namespace
+
 vfps::HDF5File::HDF5File(const std::string filename,
                          const std::shared_ptr<PhaseSpace> ps,
                          const ElectricField* ef,
@@ -17,16 +53,38 @@ vfps::HDF5File::HDF5File(const std::string filename,
                          const WakeFunctionMap* wfm,
                          const size_t nparticles,
                          const double t_sync,
-                         const double f_rev)
+                         const double f_rev,
+                         const size_t asyncbytes,
+                         const uint32_t compressionthreads,
+                         const OutputProfile profile,
+                         const uint32_t swmrinterval,
+                         const SpectrumSettings spectrum,
+                         const std::set<OutputGroup> ownaxes)
   : _fname( filename )
+  #if H5_VERS_MAJOR == 1 and H5_VERS_MINOR < 10
+  , _swmrinterval( 0 )
+  #else
+  , _swmrinterval( swmrinterval )
+  #endif
   , _file( _prepareFile() )
+  , _swmrstarted( false )
+  , _lastflush( std::chrono::steady_clock::now() )
   , _nBuckets( (ef != nullptr)? ef->getBuckets().size() : 0)
   , _nBunches( PhaseSpace::nb )
   , _nParticles( nparticles )
   , _psSizeX( PhaseSpace::nx )
   , _psSizeY( PhaseSpace::ny )
   , _maxn( (ef != nullptr)? ef->getNMax()/static_cast<size_t>(2) : 0 )
+  , _spectrumBins( _makeSpectrumBins(ef,spectrum) )
+  , _nFreqs( _spectrumBins.empty()? _maxn : _spectrumBins.size() )
+  , _spectrum( _nBunches*_nFreqs )
   , _impSize( imp != nullptr ? imp->nFreqs()/2 : 0 )
+  , _profile( profile )
+  #if INOVESA_USE_ZLIB == 1
+  , _compressionthreads( compressionthreads )
+  #else
+  , _compressionthreads( 0 )
+  #endif // INOVESA_USE_ZLIB
   , _positionAxis(_makeDatasetInfo<1,meshaxis_t>( "/Info/AxisValues_z"
                                                 , {{_psSizeX}}
                                                 , {{std::min(2048U,_psSizeX)}}
@@ -57,7 +115,8 @@ vfps::HDF5File::HDF5File(const std::string filename,
                                                , {{ 64, 1
                                                   , std::min(256U,_psSizeX) }}
                                                , {{ H5S_UNLIMITED,_nBunches
-                                                  , _psSizeX }} ))
+                                                  , _psSizeX }}
+                                               , _profile.quantize))
   , _paddedProfile(_makeDatasetInfo<2,integral_t>("/BunchProfile/padded"
                                                  , {{0,_impSize}}
                                                  , {{2,std::min(256U,_psSizeX)}}
@@ -75,7 +134,8 @@ vfps::HDF5File::HDF5File(const std::string filename,
                                                  , {{ 64, 1
                                                     , std::min(256U,_psSizeX) }}
                                                  , {{ H5S_UNLIMITED,_nBunches
-                                                    , _psSizeX }} ))
+                                                    , _psSizeX }}
+                                                  , _profile.quantize))
   , _energySpread( _makeDatasetInfo<2,meshaxis_t>( "/EnergySpread/data"
                                                  , {{ 0, _nBunches }}
                                                  , {{ 256, 1 }}
@@ -107,23 +167,34 @@ vfps::HDF5File::HDF5File(const std::string filename,
                                                  , {{2,std::min(256U,_psSizeX)}}
                                                  , {{H5S_UNLIMITED,_impSize}}))
   , _csrSpectrum(_makeDatasetInfo<3,meshaxis_t>( "/CSR/Spectrum/data"
-                                               , {{ 0, _nBunches, _maxn }}
+                                               , {{ 0, _nBunches, _nFreqs }}
                                                , {{ 64, 1
-                                                  , std::min(256U,_maxn) }}
+                                                  , std::min(256U,_nFreqs) }}
                                                , {{ H5S_UNLIMITED,_nBunches
-                                                  , _maxn }} ))
+                                                  , _nFreqs }} ))
   , _csrIntensity(_makeDatasetInfo<2,meshaxis_t>( "/CSR/Intensity/data"
                                                 , {{ 0, _nBunches }}
                                                 , {{ 64, 1 }}
                                                 , {{ H5S_UNLIMITED
                                                   ,_nBunches }} ))
+  , _timeAxisCSRStep(_makeDatasetInfo<1,timeaxis_t>( "/CSR/IntensityPerStep/axis0"
+                                           , {{0}},{{4096}},{{H5F_UNLIMITED}}))
+  , _csrIntensityPerStep(_makeDatasetInfo<2,meshaxis_t>(
+                                                  "/CSR/IntensityPerStep/data"
+                                                , {{ 0, _nBunches }}
+                                                , {{ 4096, 1 }}
+                                                , {{ H5S_UNLIMITED
+                                                  ,_nBunches }} ))
   , _phaseSpace(_makeDatasetInfo<4,meshdata_t>( "/PhaseSpace/data"
                                               , {{ 0, _nBunches, _psSizeX, _psSizeY }}
                                               , {{ 64, 1
                                                  , std::min(256U,_psSizeX)
                                                  , std::min(256U,_psSizeY) }}
                                               , {{ H5S_UNLIMITED,_nBunches
-                                                 , _psSizeX, _psSizeY }} ))
+                                                 , _psSizeX, _psSizeY }}
+                                              , _profile.quantize))
+  , _snapshotCount(0)
+  , _snapshotOffset(0)
   , _impedanceReal(_makeDatasetInfo<1,csrpower_t>("/Impedance/data/real"
                                                  , {{_impSize}}
                                                  , {{std::min( 4097U,_impSize)}}
@@ -137,6 +208,10 @@ vfps::HDF5File::HDF5File(const std::string filename,
                                                  , {{std::min( 4097U
                                                              , 2U*_psSizeX)}}
                                                  , {{2*_psSizeX}}))
+  , _asyncbytes(asyncbytes)
+  , _queuedbytes(0)
+  , _writing(false)
+  , _stop(false)
   , _ps(ps)
 {
     // Axis
@@ -186,9 +261,29 @@ vfps::HDF5File::HDF5File(const std::string filename,
     }
 
 
+    // groups saved at other times than the moments have their own time axis
+    if (ownaxes.count(OutputGroup::Profiles) > 0) {
+        _timeAxisProfiles = _makeTimeAxisInfo("/BunchProfile/axis0"
+                                             , t_sync,f_rev);
+    }
+    if (ownaxes.count(OutputGroup::Spectra) > 0 && ef != nullptr) {
+        _timeAxisSpectrum = _makeTimeAxisInfo("/CSR/Spectrum/axis0"
+                                             , t_sync,f_rev);
+    }
+    if (ownaxes.count(OutputGroup::Wake) > 0 && ef != nullptr) {
+        _timeAxisWake = _makeTimeAxisInfo("/WakePotential/axis0"
+                                         , t_sync,f_rev);
+    }
+    if (ownaxes.count(OutputGroup::Tracks) > 0) {
+        _timeAxisTracks = _makeTimeAxisInfo("/Particles/axis0"
+                                           , t_sync,f_rev);
+    }
+
     // actual data
 
-    _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/BunchProfile/axis0" );
+    if (!_timeAxisProfiles) {
+        _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/BunchProfile/axis0" );
+    }
     _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_z", "/BunchProfile/axis1" );
 
     _bunchProfile.dataset.createAttribute( "AmperePerNBL"
@@ -216,7 +311,9 @@ vfps::HDF5File::HDF5File(const std::string filename,
     _bunchPosition.dataset.createAttribute("Second",H5::PredType::IEEE_F64LE,
             H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&ax_z_seconds);
 
-    _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/EnergyProfile/axis0" );
+    _file.link( H5L_TYPE_SOFT
+              , _timeAxisProfiles? "/BunchProfile/axis0" : "/Info/AxisValues_t"
+              , "/EnergyProfile/axis0" );
     _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_E", "/EnergyProfile/axis1" );
 
     _energyProfile.dataset.createAttribute("AmperePerNES",H5::PredType::IEEE_F64LE,
@@ -235,12 +332,16 @@ vfps::HDF5File::HDF5File(const std::string filename,
             H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&ax_E_eVolt);
 
 
-    _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/Particles/axis0" );
+    if (!_timeAxisTracks) {
+        _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/Particles/axis0" );
+    }
 
 
     // get ready to save WakePotential
     if (ef != nullptr) {
-        _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/WakePotential/axis0" );
+        if (!_timeAxisWake) {
+            _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/WakePotential/axis0" );
+        }
         _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_z", "/WakePotential/axis1" );
 
         _wakePotential.dataset.createAttribute("Volt",H5::PredType::IEEE_F64LE,
@@ -248,8 +349,35 @@ vfps::HDF5File::HDF5File(const std::string filename,
                                        &(ef->volts));
 
 
-        _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/CSR/Spectrum/axis0" );
-        _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_f", "/CSR/Spectrum/axis1" );
+        if (!_timeAxisSpectrum) {
+            _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_t", "/CSR/Spectrum/axis0" );
+        }
+        if (_spectrumBins.empty()) {
+            _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_f", "/CSR/Spectrum/axis1" );
+        } else {
+            // reduced spectrum has its own frequency axis
+            auto axis = _makeDatasetInfo<1,frequency_t>( "/CSR/Spectrum/axis1"
+                                                       , {{_nFreqs}}
+                                                       , {{std::min(2048U,_nFreqs)}}
+                                                       , {{_nFreqs}});
+            std::vector<frequency_t> freqs;
+            freqs.reserve(_nFreqs);
+            for (const auto& bin : _spectrumBins) {
+                freqs.emplace_back(bin.frequency);
+            }
+            axis.dataset.write(freqs.data(),axis.datatype);
+
+            const double ax_f_hertz = ef->getFreqRuler()->scale("Hertz");
+            axis.dataset.createAttribute("Hertz",H5::PredType::IEEE_F64LE,
+                    H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&ax_f_hertz);
+
+            const std::string binning = (spectrum.bins == 0)? "none"
+                                      : spectrum.logarithmic? "logarithmic"
+                                                            : "linear";
+            H5::StrType strtype(H5::PredType::C_S1,binning.size());
+            axis.dataset.createAttribute("Binning",strtype,H5::DataSpace())
+                    .write(strtype,binning);
+        }
 
         _csrIntensity.dataset.createAttribute("WattPerHertz",H5::PredType::IEEE_F64LE,
                 H5::DataSpace()).write(H5::PredType::IEEE_F64LE,
@@ -261,6 +389,10 @@ vfps::HDF5File::HDF5File(const std::string filename,
         _csrIntensity.dataset.createAttribute("Watt",H5::PredType::IEEE_F64LE,
                 H5::DataSpace()).write(H5::PredType::IEEE_F64LE,
                                        &ef->factor4Watts);
+
+        _csrIntensityPerStep.dataset.createAttribute("Watt"
+                , H5::PredType::IEEE_F64LE, H5::DataSpace()).write(
+                    H5::PredType::IEEE_F64LE, &ef->factor4Watts);
     }
 
     /* The phase space has its own time axis.
@@ -272,9 +404,59 @@ vfps::HDF5File::HDF5File(const std::string filename,
     _timeAxisPS.dataset.createAttribute("Turn",H5::PredType::IEEE_F64LE,
                 H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&axis_t_turns);
 
+    // same for the CSR intensity that might be saved every step
+    _timeAxisCSRStep.dataset.createAttribute("Second",H5::PredType::IEEE_F64LE,
+                H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&t_sync);
+    _timeAxisCSRStep.dataset.createAttribute("Turn",H5::PredType::IEEE_F64LE,
+                H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&axis_t_turns);
+
     _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_z", "/PhaseSpace/axis1" );
     _file.link(H5L_TYPE_SOFT, "/Info/AxisValues_E", "/PhaseSpace/axis2" );
 
+    if (_profile.quantize) {
+        _bunchProfileQuant = _makeQuantizationInfo("/BunchProfile/quantization");
+        _energyProfileQuant = _makeQuantizationInfo("/EnergyProfile/quantization");
+        _phaseSpaceQuant = _makeQuantizationInfo("/PhaseSpace/quantization");
+    }
+
+    if (_profile.snapshots) {
+        if (_profile.quantize) {
+            throw std::invalid_argument("Phase space snapshots "
+                                        "cannot be quantized.");
+        }
+        H5::Group snapshot = _file.createGroup("/PhaseSpace/snapshot");
+        _phaseSpaceValues = std::make_unique<DatasetInfo<1>>(
+                    _makeDatasetInfo<1,meshdata_t>( "/PhaseSpace/snapshot/values"
+                                                  , {{ 0 }}
+                                                  , {{ 65536 }}
+                                                  , {{ H5S_UNLIMITED }}));
+        _phaseSpaceIndex = std::make_unique<DatasetInfo<3>>(
+                    _makeDatasetInfo<3,uint64_t>( "/PhaseSpace/snapshot/index"
+                                                , {{ 0, _nBunches, 6 }}
+                                                , {{ 256, 1, 6 }}
+                                                , {{ H5S_UNLIMITED
+                                                   , _nBunches, 6 }}));
+        const std::string columns("offset x0 nx y0 ny keyframe");
+        H5::StrType strtype(H5::PredType::C_S1,columns.size());
+        _phaseSpaceIndex->dataset.createAttribute("Columns",strtype
+                                                 , H5::DataSpace())
+                .write(strtype,columns);
+        snapshot.createAttribute("Threshold",H5::PredType::IEEE_F64LE,
+                H5::DataSpace()).write(H5::PredType::IEEE_F64LE,
+                                       &_profile.snapshotthreshold);
+        snapshot.createAttribute("KeyframeInterval",H5::PredType::STD_U32LE,
+                H5::DataSpace()).write(H5::PredType::NATIVE_UINT32,
+                                       &_profile.keyframeinterval);
+        const std::string differences("bitwise XOR");
+        H5::StrType difftype(H5::PredType::C_S1,differences.size());
+        snapshot.createAttribute("Differences",difftype,H5::DataSpace())
+                .write(difftype,differences);
+        if (_profile.keyframeinterval > 1) {
+            _snapshotReference.resize(static_cast<size_t>(_nBunches)
+                                      *_psSizeX*_psSizeY);
+        }
+    }
+
     _phaseSpace.dataset.createAttribute("AmperePerNBLPerNES",H5::PredType::IEEE_F64LE,
             H5::DataSpace()).write(H5::PredType::IEEE_F64LE,
                                    &ps->current);
@@ -335,6 +517,142 @@ vfps::HDF5File::HDF5File(const std::string filename,
                     ("/Info/Inovesa_build", H5::PredType::C_S1,ver_string_dspace);
     ver_string_dset.write(ver_string.c_str(),H5::PredType::C_S1);
     }
+
+    // save output profile
+    {
+    H5::Group info = _file.openGroup("/Info");
+    for (const auto& attr : { std::make_pair("OutputProfile",_profile.name)
+                            , std::make_pair("OutputOverrides"
+                                            ,_profile.overrides)}) {
+        H5::StrType strtype(H5::PredType::C_S1
+                           , std::max<size_t>(attr.second.size(),1));
+        info.createAttribute(attr.first,strtype,H5::DataSpace())
+                .write(strtype,attr.second);
+    }
+    const int32_t quantized = _profile.quantize;
+    info.createAttribute("QuantizedOutput",H5::PredType::STD_I32LE,
+            H5::DataSpace()).write(H5::PredType::NATIVE_INT32,&quantized);
+    }
+
+    if (_asyncbytes > 0) {
+        _writer = std::thread(&HDF5File::_writeLoop,this);
+    }
+}
+
+vfps::HDF5File::~HDF5File()
+{
+    if (_writer.joinable()) {
+        {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+        }
+        _cv.notify_all();
+        _writer.join();
+    }
+    try {
+        _flushBuffers();
+    } catch (H5::Exception& e) {
+       #if H5_VERS_MAJOR == 1 and H5_VERS_MINOR < 10
+       e.printError();
+       #else
+       e.printErrorStack();
+       #endif
+    }
+}
+
+void vfps::HDF5File::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock,[this]{ return _jobs.empty() && !_writing; });
+}
+
+vfps::HDF5File::OutputProfile::OutputProfile( const std::string& name
+                                             , const std::string& overrides)
+  : name(name)
+  , overrides(overrides)
+  , defaults({6,true,{},0})
+  , rowchunks(false)
+  , quantize(false)
+  , snapshots(false)
+  , snapshotthreshold(0)
+  , keyframeinterval(1)
+{
+    if (name == "fast") {
+        defaults.compression = 1;
+        rowchunks = true;
+    } else if (name == "archive") {
+        defaults.compression = 9;
+    } else if (name != "balanced") {
+        throw std::invalid_argument("Unknown output profile \""+name+"\".");
+    }
+
+    std::istringstream entries(overrides);
+    std::string entry;
+    while (std::getline(entries,entry,';')) {
+        if (entry.empty()) {
+            continue;
+        }
+        const auto colon = entry.find(':');
+        std::string dataset = entry.substr(0,colon);
+        if (dataset.empty() || dataset == "/") {
+            throw std::invalid_argument("Missing dataset in output setting \""
+                                        +entry+"\".");
+        }
+        if (dataset.front() != '/') {
+            dataset = '/' + dataset;
+        }
+        StorageSettings settings = get(dataset);
+        std::istringstream keys(colon == std::string::npos
+                                ? "" : entry.substr(colon+1));
+        std::string keyvalue;
+        while (std::getline(keys,keyvalue,',')) {
+            const auto eq = keyvalue.find('=');
+            const std::string key = keyvalue.substr(0,eq);
+            const std::string value = (eq == std::string::npos)
+                                    ? "" : keyvalue.substr(eq+1);
+            try {
+                if (key == "compression") {
+                    const auto level = std::stoul(value);
+                    if (level > 9) {
+                        throw std::out_of_range(value);
+                    }
+                    settings.compression = level;
+                } else if (key == "shuffle") {
+                    settings.shuffle = std::stoul(value) > 0;
+                } else if (key == "cache") {
+                    settings.chunkcache = std::stoul(value)*1024*1024;
+                } else if (key == "chunk") {
+                    settings.chunkdims.clear();
+                    std::istringstream dims(value);
+                    std::string dim;
+                    while (std::getline(dims,dim,'x')) {
+                        settings.chunkdims.push_back(std::stoul(dim));
+                    }
+                } else {
+                    throw std::invalid_argument(key);
+                }
+            } catch (std::logic_error&) {
+                throw std::invalid_argument("Invalid output setting \""
+                                            +keyvalue+"\" for "+dataset
+                                            +((key == "compression")
+                                             ? " (level has to be 0 to 9)."
+                                             : "."));
+            }
+        }
+        datasets[dataset] = settings;
+    }
+}
+
+vfps::HDF5File::StorageSettings
+vfps::HDF5File::OutputProfile::get(const std::string& dataset) const
+{
+    // "/Group" also applies to "/Group/data"
+    for (const auto& ds : datasets) {
+        if (dataset == ds.first || dataset == ds.first+"/data") {
+            return ds.second;
+        }
+    }
+    return defaults;
 }
 
 void vfps::HDF5File::addParameterToGroup(std::string groupname,
@@ -342,16 +660,52 @@ void vfps::HDF5File::addParameterToGroup(std::string groupname,
                                          H5::PredType type,
                                          void* data)
 {
+    // the writer thread must not access the file at the same time
+    flush();
     H5::Group group = _file.openGroup(groupname);
     group.createAttribute(paramname,type, H5::DataSpace()).write(type,data);
 }
 
-void vfps::HDF5File::append(const ElectricField* ef, const bool fullspectrum)
+void vfps::HDF5File::append( const ElectricField* ef, const timeaxis_t t
+                            , const bool intensity, const bool spectrum)
 {
-    if (fullspectrum) {
-        _appendData(_csrSpectrum,ef->getCSRSpectrum());
+    if (spectrum) {
+        if (_timeAxisSpectrum) {
+            _appendData(*_timeAxisSpectrum,&t);
+        }
+        const csrpower_t* spectrum = ef->getCSRSpectrum();
+        const size_t nmax = ef->getNMax();
+        auto out = _spectrum.begin();
+        for (uint32_t b=0; b<_nBunches; b++) {
+            const csrpower_t* in = spectrum+b*nmax;
+            if (_spectrumBins.empty()) {
+                out = std::copy_n(in,_nFreqs,out);
+            }
+            for (const auto& bin : _spectrumBins) {
+                if (bin.last > bin.first) {
+                    double sum = 0;
+                    for (size_t i=bin.first; i<bin.last; i++) {
+                        sum += in[i];
+                    }
+                    *out++ = sum/(bin.last-bin.first);
+                } else {
+                    *out++ = (1-bin.weight)*in[bin.first]
+                           + bin.weight*in[bin.first+1];
+                }
+            }
+        }
+        _appendData(_csrSpectrum,_spectrum.data());
+    }
+    if (intensity) {
+        _appendData(_csrIntensity,ef->getCSRPower());
     }
-    _appendData(_csrIntensity,ef->getCSRPower());
+}
+
+void vfps::HDF5File::appendCSRIntensity( const ElectricField* ef
+                                        , const timeaxis_t t)
+{
+    _appendData(_timeAxisCSRStep,&t);
+    _appendData(_csrIntensityPerStep,ef->getCSRPower());
 }
 
 void vfps::HDF5File::appendPadded(const vfps::ElectricField *ef)
@@ -366,7 +720,12 @@ void vfps::HDF5File::appendRFKicks(
     _appendData(_dynamicRFKick,kicks.data(),kicks.size());
 }
 
-void vfps::HDF5File::appendTracks(const std::vector<PhaseSpace::Position> &p){
+void vfps::HDF5File::appendTracks( const std::vector<PhaseSpace::Position> &p
+                                  , const timeaxis_t t)
+{
+    if (_timeAxisTracks) {
+        _appendData(*_timeAxisTracks,&t);
+    }
     std::vector<PhaseSpace::Position> physcords;
     physcords.reserve(_nParticles);
     for (auto pos : p) {
@@ -383,18 +742,44 @@ void vfps::HDF5File::append(const PhaseSpace& ps,
     if ( at == AppendType::All ||
          at == AppendType::PhaseSpace) {
         _appendData(_timeAxisPS,&t);
-        _appendData(_phaseSpace,ps.getData());
+        if (_phaseSpaceValues) {
+            _appendSnapshot(ps.getData());
+        } else if (_phaseSpaceQuant) {
+            _appendQuantized(_phaseSpace,*_phaseSpaceQuant,ps.getData());
+        } else {
+            _appendData(_phaseSpace,ps.getData());
+        }
+    }
+
+    if ( at == AppendType::All ||
+         at == AppendType::Defaults ||
+         at == AppendType::Profiles) {
+        if (_timeAxisProfiles) {
+            _appendData(*_timeAxisProfiles,&t);
+        }
+        if (_bunchProfileQuant) {
+            _appendQuantized( _bunchProfile,*_bunchProfileQuant
+                            , ps.getProjection(0).data());
+        } else {
+            _appendData(_bunchProfile,ps.getProjection(0).data());
+        }
+        if (_energyProfileQuant) {
+            _appendQuantized( _energyProfile,*_energyProfileQuant
+                            , ps.getProjection(1).data());
+        } else {
+            _appendData(_energyProfile,ps.getProjection(1).data());
+        }
     }
 
-    if (at != AppendType::PhaseSpace) {
+    if ( at == AppendType::All ||
+         at == AppendType::Defaults ||
+         at == AppendType::Moments) {
         _appendData(_timeAxis,&t);
-        _appendData(_bunchProfile,ps.getProjection(0).data());
         _appendData(_bunchLength,ps.getBunchLength());
         {
         auto mean_q = ps.getMoment(0,0);
         _appendData(_bunchPosition,mean_q.data());
         }
-        _appendData(_energyProfile,ps.getProjection(1).data());
         _appendData(_energySpread,ps.getEnergySpread());
         {
         auto mean_E = ps.getMoment(1,0);
@@ -406,8 +791,11 @@ void vfps::HDF5File::append(const PhaseSpace& ps,
     }
 }
 
-void vfps::HDF5File::append(const vfps::WakeKickMap* wkm)
+void vfps::HDF5File::append(const vfps::WakeKickMap* wkm, const timeaxis_t t)
 {
+    if (_timeAxisWake) {
+        _appendData(*_timeAxisWake,&t);
+    }
     _appendData(_wakePotential,wkm->getForce());
 }
 
@@ -437,9 +825,23 @@ vfps::HDF5File::readPhaseSpace( std::string fname
     std::vector<hsize_t> ps_dims(rank);
     ps_space.getSimpleExtentDims( ps_dims.data(), nullptr );
 
+    // phase space might be saved as snapshots, see _appendSnapshot()
+    const bool snapshots = H5Lexists( file.getId(), "/PhaseSpace/snapshot"
+                                    , H5P_DEFAULT) > 0;
+    hsize_t nsteps = ps_dims[0];
+    std::vector<uint64_t> index;
+    if (snapshots) {
+        H5::DataSet idx_dataset = file.openDataSet("/PhaseSpace/snapshot/index");
+        std::array<hsize_t,3> idx_dims;
+        idx_dataset.getSpace().getSimpleExtentDims(idx_dims.data(),nullptr);
+        nsteps = idx_dims[0];
+        index.resize(idx_dims[0]*idx_dims[1]*idx_dims[2]);
+        idx_dataset.read(index.data(),H5::PredType::NATIVE_UINT64);
+    }
+
     std::vector<hsize_t> ps_offset;
     std::vector<hsize_t> ps_ext;
-    use_step = (ps_dims[0]+use_step)%ps_dims[0];
+    use_step = (nsteps+use_step)%nsteps;
     meshindex_t ps_size;
     uint32_t nBunches = 1U;
     switch (rank) {
@@ -456,7 +858,9 @@ vfps::HDF5File::readPhaseSpace( std::string fname
         break;
     }
     H5::DataSpace memspace(rank,ps_ext.data(),nullptr);
-    ps_space.selectHyperslab(H5S_SELECT_SET, ps_ext.data(), ps_offset.data());
+    if (!snapshots) {
+        ps_space.selectHyperslab(H5S_SELECT_SET, ps_ext.data(), ps_offset.data());
+    }
 
     H5::DataType axistype;
     if (std::is_same<vfps::meshaxis_t,float>::value) {
@@ -474,7 +878,76 @@ vfps::HDF5File::readPhaseSpace( std::string fname
                                           , oclh
                                           , Qb,Ib_unscaled,filling,1
                                           );
-    ps_dataset.read(ps->getData(), datatype, memspace, ps_space);
+    if (snapshots) {
+        H5::DataSet val_dataset = file.openDataSet("/PhaseSpace/snapshot/values");
+        H5::DataSpace val_space(val_dataset.getSpace());
+
+        // differences are applied starting from the last keyframe
+        hsize_t step = use_step;
+        while (step > 0 && index[step*nBunches*6+5] == 0) {
+            step--;
+        }
+
+        const size_t n = static_cast<size_t>(ps_size)*ps_size;
+        meshdata_t* data = ps->getData();
+        std::vector<meshdata_t> values;
+        for (; step <= static_cast<hsize_t>(use_step); step++) {
+            for (size_t b=0; b<std::min<size_t>(nBunches,PhaseSpace::nb); b++) {
+                const uint64_t* entry = &index[(step*nBunches+b)*6];
+                const size_t x0 = entry[1], nx = entry[2];
+                const size_t y0 = entry[3], ny = entry[4];
+                const bool keyframe = entry[5] > 0;
+                const hsize_t count = nx*ny;
+                values.resize(count);
+                if (count > 0) {
+                    const hsize_t offset = entry[0];
+                    val_space.selectHyperslab(H5S_SELECT_SET,&count,&offset);
+                    H5::DataSpace val_memspace(1,&count,nullptr);
+                    val_dataset.read( values.data(), datatype
+                                    , val_memspace, val_space);
+                }
+                meshdata_t* const frame = data+b*n;
+                auto value = values.cbegin();
+                for (size_t x=0; x<ps_size; x++) {
+                    for (size_t y=0; y<ps_size; y++) {
+                        const size_t i = x*ps_size+y;
+                        if (x < x0 || x >= x0+nx || y < y0 || y >= y0+ny) {
+                            frame[i] = 0;
+                        } else if (keyframe) {
+                            frame[i] = *value++;
+                        } else {
+                            frame[i] = bitwiseXor(frame[i],*value++);
+                        }
+                    }
+                }
+            }
+        }
+    } else if (ps_dataset.getDataType().getClass() == H5T_INTEGER) {
+        // quantized phase space, see _appendQuantized()
+        const size_t n = static_cast<size_t>(ps_size)*ps_size;
+        std::vector<uint16_t> quantized(nBunches*n);
+        ps_dataset.read( quantized.data(), H5::PredType::NATIVE_UINT16
+                       , memspace, ps_space);
+
+        H5::DataSet q_dataset = file.openDataSet("/PhaseSpace/quantization");
+        H5::DataSpace q_space(q_dataset.getSpace());
+        const std::array<hsize_t,3> q_offset{{ ps_offset[0],0,0 }};
+        const std::array<hsize_t,3> q_ext{{ 1,nBunches,2 }};
+        q_space.selectHyperslab(H5S_SELECT_SET, q_ext.data(), q_offset.data());
+        H5::DataSpace q_memspace(3,q_ext.data(),nullptr);
+        std::vector<double> scaling(2*nBunches);
+        q_dataset.read( scaling.data(), H5::PredType::NATIVE_DOUBLE
+                      , q_memspace, q_space);
+
+        meshdata_t* data = ps->getData();
+        for (size_t b=0; b<std::min<size_t>(nBunches,PhaseSpace::nb); b++) {
+            for (size_t i=b*n; i<(b+1)*n; i++) {
+                data[i] = scaling[2*b] + scaling[2*b+1]*quantized[i];
+            }
+        }
+    } else {
+        ps_dataset.read(ps->getData(), datatype, memspace, ps_space);
+    }
 
     return ps;
 }
@@ -484,6 +957,252 @@ void vfps::HDF5File::_appendData(DatasetInfo<rank>& ds
                                 , const datatype* const data
                                 , const size_t size)
 {
+    // datatype might be compound (e.g. PhaseSpace::Position)
+    size_t bytes = size*ds.elemsize;
+    for (int d=1; d<rank; d++) {
+        bytes *= ds.dims[d];
+    }
+    _enqueue([this,&ds,size](const char* buf) {
+                _writeData(ds,buf,size);
+             }, data, bytes);
+}
+
+template <int rank>
+void vfps::HDF5File::_writeData(DatasetInfo<rank>& ds
+                               , const char* const data
+                               , const size_t size)
+{
+    if (ds.bufferrows <= 1) {
+        _writeRows(ds,data,size);
+        _swmrFlush();
+        return;
+    }
+    size_t bytes = size*ds.elemsize;
+    for (int d=1; d<rank; d++) {
+        bytes *= ds.dims[d];
+    }
+    ds.buffer.insert(ds.buffer.end(),data,data+bytes);
+    ds.buffered += size;
+    /* Rows up to the next chunk boundary. (Chunks are incomplete
+     * after partial buffers have been written by _swmrFlush().)
+     */
+    const hsize_t first = ds.bufferrows - ds.dims[0]%ds.bufferrows;
+    if (ds.buffered >= first) {
+        // write whole chunks, keep the rest
+        const hsize_t rows = ds.buffered - (ds.buffered-first)%ds.bufferrows;
+        const size_t rowbytes = ds.buffer.size()/ds.buffered;
+        _writeRows(ds,ds.buffer.data(),rows);
+        ds.buffer.erase(ds.buffer.begin(),ds.buffer.begin()+rows*rowbytes);
+        ds.buffered -= rows;
+    }
+    _swmrFlush();
+}
+
+void vfps::HDF5File::_swmrFlush()
+{
+    if (_swmrstarted) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - _lastflush >= std::chrono::seconds(_swmrinterval)) {
+            _flushBuffers();
+            _file.flush(H5F_SCOPE_GLOBAL);
+            _lastflush = now;
+        }
+    }
+}
+
+template <int rank>
+void vfps::HDF5File::_flushBuffer(DatasetInfo<rank>& ds)
+{
+    if (ds.buffered > 0) {
+        _writeRows(ds,ds.buffer.data(),ds.buffered);
+        ds.buffer.clear();
+        ds.buffered = 0;
+    }
+}
+
+void vfps::HDF5File::_flushBuffers()
+{
+    _flushBuffer(_timeAxis);
+    _flushBuffer(_timeAxisPS);
+    _flushBuffer(_bunchPopulation);
+    _flushBuffer(_bunchProfile);
+    _flushBuffer(_paddedProfile);
+    _flushBuffer(_bunchLength);
+    _flushBuffer(_bunchPosition);
+    _flushBuffer(_energyProfile);
+    _flushBuffer(_energySpread);
+    _flushBuffer(_energyAverage);
+    _flushBuffer(_particles);
+    _flushBuffer(_dynamicRFKick);
+    _flushBuffer(_wakePotential);
+    _flushBuffer(_paddedPotential);
+    _flushBuffer(_csrSpectrum);
+    _flushBuffer(_csrIntensity);
+    _flushBuffer(_timeAxisCSRStep);
+    _flushBuffer(_csrIntensityPerStep);
+    _flushBuffer(_phaseSpace);
+    for (auto quant : { _bunchProfileQuant.get()
+                      , _energyProfileQuant.get()
+                      , _phaseSpaceQuant.get()}) {
+        if (quant != nullptr) {
+            _flushBuffer(*quant);
+        }
+    }
+    if (_phaseSpaceValues) {
+        _flushBuffer(*_phaseSpaceValues);
+        _flushBuffer(*_phaseSpaceIndex);
+    }
+    for (auto axis : { _timeAxisProfiles.get()
+                     , _timeAxisSpectrum.get()
+                     , _timeAxisWake.get()
+                     , _timeAxisTracks.get()}) {
+        if (axis != nullptr) {
+            _flushBuffer(*axis);
+        }
+    }
+}
+
+template <int rank>
+void vfps::HDF5File::_writeChunks(DatasetInfo<rank>& ds
+                                 , const char* const data
+                                 , const size_t size)
+{
+    #if INOVESA_USE_ZLIB == 1
+    const size_t elemsize = ds.elemsize;
+    auto extent = ds.dims;
+    extent[0] = size;
+    std::array<hsize_t,rank> nchunks;
+    size_t total = 1;
+    size_t chunkelems = 1;
+    for (int d=0; d<rank; d++) {
+        nchunks[d] = (extent[d]+ds.chunkdims[d]-1)/ds.chunkdims[d];
+        total *= nchunks[d];
+        chunkelems *= ds.chunkdims[d];
+    }
+    const size_t chunkbytes = chunkelems*elemsize;
+    const size_t linelen = ds.chunkdims[rank-1];
+
+    auto chunkStart = [&](size_t c) {
+        std::array<hsize_t,rank> start;
+        for (int d=rank-1; d>=0; d--) {
+            start[d] = (c%nchunks[d])*ds.chunkdims[d];
+            c /= nchunks[d];
+        }
+        return start;
+    };
+
+    std::vector<std::vector<Bytef>> compressed(total);
+    std::vector<int> status(total,Z_OK);
+    auto compressChunk = [&](size_t c) {
+        const auto start = chunkStart(c);
+        // edge chunks are padded with zeros
+        std::vector<char> chunk(chunkbytes,0);
+        const size_t len = std::min<size_t>( linelen
+                                           , extent[rank-1]-start[rank-1]);
+        for (size_t l=0; l<chunkelems/linelen; l++) {
+            std::array<hsize_t,rank> i;
+            i[rank-1] = 0;
+            size_t r = l;
+            bool inside = true;
+            for (int d=rank-2; d>=0; d--) {
+                i[d] = r%ds.chunkdims[d];
+                r /= ds.chunkdims[d];
+                inside &= (start[d]+i[d] < extent[d]);
+            }
+            if (inside) {
+                size_t src = 0;
+                for (int d=0; d<rank; d++) {
+                    src = src*extent[d] + start[d] + i[d];
+                }
+                std::memcpy( chunk.data()+l*linelen*elemsize
+                           , data+src*elemsize, len*elemsize);
+            }
+        }
+        const Bytef* src = reinterpret_cast<const Bytef*>(chunk.data());
+        std::vector<Bytef> shuffled;
+        if (ds.shuffle) {
+            // same as HDF5's shuffle filter: group bytes of same significance
+            shuffled.resize(chunkbytes);
+            for (size_t e=0; e<chunkelems; e++) {
+                for (size_t b=0; b<elemsize; b++) {
+                    shuffled[b*chunkelems+e] = chunk[e*elemsize+b];
+                }
+            }
+            src = shuffled.data();
+        }
+        uLongf clen = compressBound(chunkbytes);
+        compressed[c].resize(clen);
+        status[c] = compress2( compressed[c].data(),&clen
+                             , src,chunkbytes,ds.compression);
+        compressed[c].resize(clen);
+    };
+
+    // (there are no chunks for datasets with an empty dimension)
+    const size_t nthreads = std::min<size_t>( _compressionthreads
+                                            , std::max<size_t>(total,1));
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads-1);
+    for (size_t t=1; t<nthreads; t++) {
+        threads.emplace_back([&,t]() {
+            for (size_t c=t; c<total; c+=nthreads) {
+                compressChunk(c);
+            }
+        });
+    }
+    for (size_t c=0; c<total; c+=nthreads) {
+        compressChunk(c);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // HDF5 itself is only used by a single thread
+    const hsize_t offset = ds.dims[0];
+    ds.dims[0] += size;
+    ds.dataset.extend(ds.dims.data());
+    for (size_t c=0; c<total; c++) {
+        auto start = chunkStart(c);
+        start[0] += offset;
+        if (status[c] != Z_OK
+                || H5Dwrite_chunk( ds.dataset.getId(),H5P_DEFAULT,0
+                                 , start.data(),compressed[c].size()
+                                 , compressed[c].data()) < 0) {
+            throw H5::DataSetIException("HDF5File::_writeChunks",
+                                        "writing compressed chunk failed");
+        }
+    }
+    #endif // INOVESA_USE_ZLIB
+}
+
+template <int rank>
+void vfps::HDF5File::_writeRows(DatasetInfo<rank>& ds
+                               , const void* const data
+                               , const size_t size)
+{
+    if (_compressionthreads > 0 && ds.compression > 0) {
+        size_t rowbytes = ds.elemsize;
+        for (int d=1; d<rank; d++) {
+            rowbytes *= ds.dims[d];
+        }
+        const char* const bytes = static_cast<const char*>(data);
+        // rows to complete a chunk that has been written partially before
+        const hsize_t fill = (ds.chunkdims[0] - ds.dims[0]%ds.chunkdims[0])
+                           % ds.chunkdims[0];
+        if (fill > 0 && size >= fill+ds.chunkdims[0]) {
+            _writeRows(ds,bytes,fill);
+            _writeRows(ds,bytes+fill*rowbytes,size-fill);
+            return;
+        }
+        if (fill == 0 && size >= ds.chunkdims[0]) {
+            const size_t chunkrows = size - size%ds.chunkdims[0];
+            _writeChunks(ds,bytes,chunkrows);
+            if (chunkrows < size) {
+                _writeRows(ds,bytes+chunkrows*rowbytes,size-chunkrows);
+            }
+            return;
+        }
+    }
+
     std::array<hsize_t,rank> offset{{ds.dims[0]}};
     auto ext = ds.dims;
     ext[0] = size;
@@ -495,12 +1214,306 @@ void vfps::HDF5File::_appendData(DatasetInfo<rank>& ds
     ds.dataset.write(data, ds.datatype,memspace, filespace);;
 }
 
+void vfps::HDF5File::_enqueue( std::function<void(const char*)> write
+                             , const void* data, const size_t bytes)
+{
+    #if H5_VERS_MAJOR > 1 or H5_VERS_MINOR >= 10
+    if (_swmrinterval > 0 && !_swmrstarted) {
+        // no more objects or attributes will be created
+        flush();
+        if (H5Fstart_swmr_write(_file.getId()) < 0) {
+            throw H5::FileIException("HDF5File::_enqueue",
+                                     "could not start SWMR mode");
+        }
+        _swmrstarted = true;
+    }
+    #endif
+    if (!_writer.joinable()) {
+        write(static_cast<const char*>(data));
+        return;
+    }
+
+    Job job;
+    job.write = std::move(write);
+    {
+    std::unique_lock<std::mutex> lock(_mutex);
+    // backpressure: a single job larger than the buffer is still accepted
+    _cv.wait(lock,[this,bytes]{ return _queuedbytes+bytes <= _asyncbytes
+                                    || (_jobs.empty() && !_writing); });
+    if (!_pool.empty()) {
+        job.data = std::move(_pool.back());
+        _pool.pop_back();
+    }
+    }
+    // copy outside of the lock, so that the writer is not blocked
+    job.data.resize(bytes);
+    if (bytes > 0) {
+        std::memcpy(job.data.data(),data,bytes);
+    }
+    {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _queuedbytes += bytes;
+    _jobs.push_back(std::move(job));
+    }
+    _cv.notify_all();
+}
+
+void vfps::HDF5File::_writeLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock,[this]{ return _stop || !_jobs.empty(); });
+        if (_jobs.empty()) {
+            // _stop was set and there is nothing left to do
+            break;
+        }
+        Job job = std::move(_jobs.front());
+        _jobs.pop_front();
+        _writing = true;
+        lock.unlock();
+
+        try {
+            job.write(job.data.data());
+        } catch (H5::Exception& e) {
+           #if H5_VERS_MAJOR == 1 and H5_VERS_MINOR < 10
+           e.printError();
+           #else
+           e.printErrorStack();
+           #endif
+            Display::abort = true;
+        }
+
+        lock.lock();
+        _writing = false;
+        _queuedbytes -= job.data.size();
+        // keep buffers for reuse, as long as they fit into the budget
+        size_t pooled = 0;
+        for (const auto& buf : _pool) {
+            pooled += buf.capacity();
+        }
+        if (pooled + job.data.capacity() <= _asyncbytes) {
+            _pool.push_back(std::move(job.data));
+        }
+        _cv.notify_all();
+    }
+}
+
+void vfps::HDF5File::_appendSnapshot(const meshdata_t* const data)
+{
+    const size_t n = static_cast<size_t>(_psSizeX)*_psSizeY;
+    const bool keyframe = (_snapshotCount%std::max(1U,_profile.keyframeinterval)
+                           == 0);
+    _snapshotCount++;
+
+    std::vector<meshdata_t> values;
+    std::vector<uint64_t> index;
+    index.reserve(6*_nBunches);
+    for (size_t b=0; b<_nBunches; b++) {
+        const meshdata_t* const frame = data+b*n;
+        meshdata_t maxval = 0;
+        for (size_t i=0; i<n; i++) {
+            maxval = std::max(maxval,std::abs(frame[i]));
+        }
+        const meshdata_t threshold = _profile.snapshotthreshold*maxval;
+
+        // bounding box of occupied cells
+        size_t x0 = _psSizeX, x1 = 0;
+        size_t y0 = _psSizeY, y1 = 0;
+        for (size_t x=0; x<_psSizeX; x++) {
+            for (size_t y=0; y<_psSizeY; y++) {
+                if (std::abs(frame[x*_psSizeY+y]) > threshold) {
+                    x0 = std::min(x0,x);
+                    x1 = std::max(x1,x);
+                    y0 = std::min(y0,y);
+                    y1 = std::max(y1,y);
+                }
+            }
+        }
+        const size_t nx = (x0 <= x1)? x1-x0+1 : 0;
+        const size_t ny = (y0 <= y1)? y1-y0+1 : 0;
+        if (nx == 0) {
+            x0 = y0 = 0;
+        }
+        index.insert(index.end(),{ _snapshotOffset+values.size()
+                                 , x0, nx, y0, ny, keyframe});
+
+        if (_snapshotReference.empty()) {
+            // there are no differences to previous snapshots
+            for (size_t x=x0; x<x0+nx; x++) {
+                values.insert( values.end()
+                             , frame+x*_psSizeY+y0, frame+x*_psSizeY+y0+ny);
+            }
+            continue;
+        }
+
+        // reconstructed like in readPhaseSpace()
+        meshdata_t* const ref = _snapshotReference.data()+b*n;
+        for (size_t x=0; x<_psSizeX; x++) {
+            for (size_t y=0; y<_psSizeY; y++) {
+                const size_t i = x*_psSizeY+y;
+                if (x < x0 || x >= x0+nx || y < y0 || y >= y0+ny) {
+                    ref[i] = 0;
+                } else if (keyframe) {
+                    values.push_back(frame[i]);
+                    ref[i] = frame[i];
+                } else {
+                    values.push_back(bitwiseXor(frame[i],ref[i]));
+                    ref[i] = frame[i];
+                }
+            }
+        }
+    }
+    _snapshotOffset += values.size();
+    _appendData(*_phaseSpaceIndex,index.data());
+    if (!values.empty()) {
+        _appendData(*_phaseSpaceValues,values.data(),values.size());
+    }
+}
+
+template <int rank, typename datatype>
+void vfps::HDF5File::_appendQuantized( DatasetInfo<rank>& ds
+                                     , DatasetInfo<3>& quant
+                                     , const datatype* const data)
+{
+    const size_t nb = ds.dims[1];
+    size_t n = 1;
+    for (int d=2; d<rank; d++) {
+        n *= ds.dims[d];
+    }
+    constexpr double qmax = std::numeric_limits<uint16_t>::max();
+    std::vector<double> scaling(2*nb);
+    _quantized.resize(nb*n);
+    for (size_t b=0; b<nb; b++) {
+        const auto minmax = std::minmax_element(data+b*n,data+(b+1)*n);
+        const double offset = *minmax.first;
+        const double scale = (*minmax.second-offset)/qmax;
+        scaling[2*b] = offset;
+        scaling[2*b+1] = scale;
+        for (size_t i=b*n; i<(b+1)*n; i++) {
+            _quantized[i] = (scale > 0)? std::lround((data[i]-offset)/scale)
+                                       : 0;
+        }
+    }
+    _appendData(quant,scaling.data());
+    _appendData(ds,_quantized.data());
+}
+
+std::unique_ptr<vfps::HDF5File::DatasetInfo<3>>
+vfps::HDF5File::_makeQuantizationInfo(std::string name)
+{
+    auto rv = std::make_unique<DatasetInfo<3>>(
+                _makeDatasetInfo<3,double>( name
+                                          , {{ 0, _nBunches, 2 }}
+                                          , {{ 256, 1, 2 }}
+                                          , {{ H5S_UNLIMITED, _nBunches, 2 }}));
+    const std::string columns("offset scale");
+    H5::StrType strtype(H5::PredType::C_S1,columns.size());
+    rv->dataset.createAttribute("Columns",strtype,H5::DataSpace())
+            .write(strtype,columns);
+    return rv;
+}
+
+std::unique_ptr<vfps::HDF5File::DatasetInfo<1>>
+vfps::HDF5File::_makeTimeAxisInfo( std::string name
+                                 , const double t_sync
+                                 , const double f_rev)
+{
+    auto rv = std::make_unique<DatasetInfo<1>>(
+                _makeDatasetInfo<1,timeaxis_t>( name
+                                              , {{0}},{{256}},{{H5F_UNLIMITED}}));
+    const double axis_t_turns = t_sync*f_rev;
+    rv->dataset.createAttribute("Second",H5::PredType::IEEE_F64LE,
+                H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&t_sync);
+    rv->dataset.createAttribute("Turn",H5::PredType::IEEE_F64LE,
+                H5::DataSpace()).write(H5::PredType::IEEE_F64LE,&axis_t_turns);
+    return rv;
+}
+
+std::vector<vfps::HDF5File::SpectrumBin>
+vfps::HDF5File::_makeSpectrumBins( const ElectricField* ef
+                                 , const SpectrumSettings& spectrum) const
+{
+    std::vector<SpectrumBin> rv;
+    if (ef == nullptr || _maxn < 2) {
+        return rv;
+    }
+    auto axfreq = ef->getFreqRuler();
+    const double hertz = axfreq->scale("Hertz");
+    const double fmin = std::max<double>(spectrum.fmin/hertz,(*axfreq)[0]);
+    const double fmax = (spectrum.fmax > 0)
+                      ? std::min<double>(spectrum.fmax/hertz,(*axfreq)[_maxn-1])
+                      : (*axfreq)[_maxn-1];
+
+    size_t first = 0;
+    while (first < _maxn && (*axfreq)[first] < fmin) {
+        first++;
+    }
+    size_t last = first;
+    while (last < _maxn && (*axfreq)[last] <= fmax) {
+        last++;
+    }
+    if (last == first) {
+        throw std::invalid_argument("No frequencies of the CSR spectrum "
+                                    "within the given window.");
+    }
+
+    if (spectrum.bins == 0) {
+        if (first > 0 || last < _maxn) {
+            for (size_t i=first; i<last; i++) {
+                rv.push_back({i,i+1,0,(*axfreq)[i]});
+            }
+        }
+        return rv;
+    }
+
+    // logarithmic bins start at the lowest non-zero frequency
+    double lower = fmin;
+    if (spectrum.logarithmic && lower <= 0) {
+        lower = (*axfreq)[std::max<size_t>(first,1)];
+    }
+    const double upper = fmax;
+    if (lower >= upper) {
+        throw std::invalid_argument("Frequency window of the CSR spectrum "
+                                    "is too small for binning.");
+    }
+    auto edge = [&](uint32_t k) {
+        const double x = double(k)/spectrum.bins;
+        return spectrum.logarithmic? lower*std::pow(upper/lower,x)
+                                   : lower+(upper-lower)*x;
+    };
+
+    size_t i = first;
+    while (i < last && (*axfreq)[i] < lower) {
+        i++;
+    }
+    for (uint32_t k=0; k<spectrum.bins; k++) {
+        const double from = edge(k);
+        const double to = edge(k+1);
+        const double center = spectrum.logarithmic? std::sqrt(from*to)
+                                                  : (from+to)/2;
+        SpectrumBin bin{i,i,0,static_cast<frequency_t>(center)};
+        while (i < last && ((*axfreq)[i] < to || k+1 == spectrum.bins)) {
+            i++;
+        }
+        bin.last = i;
+        if (bin.last == bin.first) {
+            const double pos = (center-(*axfreq)[0])/axfreq->delta();
+            bin.first = std::min<size_t>(pos,_maxn-2);
+            bin.weight = pos-bin.first;
+            bin.last = bin.first;
+        }
+        rv.push_back(bin);
+    }
+    return rv;
+}
+
 template <int rank, typename datatype>
 vfps::HDF5File::DatasetInfo<rank>
 vfps::HDF5File::_makeDatasetInfo( std::string name
                                 , std::array<hsize_t,rank> dims
                                 , std::array<hsize_t,rank> chunkdims
                                 , std::array<hsize_t,rank> maxdims
+                                , const bool quantized
                                 )
 {
     for (auto& dim : chunkdims) {
@@ -511,33 +1524,99 @@ vfps::HDF5File::_makeDatasetInfo( std::string name
     }
 
     H5::DataType rv_datatype;
-    if (std::is_same<datatype,float>::value) {
+    if (quantized || std::is_same<datatype,uint16_t>::value) {
+        rv_datatype = H5::PredType::NATIVE_UINT16;
+    } else if (std::is_same<datatype,float>::value) {
         rv_datatype = H5::PredType::IEEE_F32LE;
     } else if (std::is_same<datatype,double>::value) {
         rv_datatype = H5::PredType::IEEE_F64LE;
     }else if (std::is_same<datatype,uint32_t>::value) {
         rv_datatype = H5::PredType::NATIVE_UINT32;
+    }else if (std::is_same<datatype,uint64_t>::value) {
+        rv_datatype = H5::PredType::NATIVE_UINT64;
     } else {
         throw std::string("Unknown datatype.");
     }
 
+    const auto settings = _profile.get(name);
+    if (!settings.chunkdims.empty()) {
+        if (settings.chunkdims.size() != rank) {
+            throw std::invalid_argument("Chunk dimensions for \""+name
+                                        +"\" do not match its rank.");
+        }
+        std::copy( settings.chunkdims.begin(),settings.chunkdims.end()
+                 , chunkdims.begin());
+    }
+
+    // appended rows are buffered to write whole chunks at once
+    hsize_t bufferrows = 1;
+    if (maxdims[0] == H5S_UNLIMITED) {
+        size_t chunkbytes = chunkdims[0]*rv_datatype.getSize();
+        for (int d=1; d<rank; d++) {
+            chunkbytes *= dims[d];
+        }
+        if (chunkbytes <= maxbufferbytes) {
+            bufferrows = chunkdims[0];
+        } else if (settings.chunkdims.empty()) {
+            if (_compressionthreads > 0 || _profile.rowchunks) {
+                // every row is written as whole chunks
+                chunkdims[0] = 1;
+            } else {
+                // fewer rows per chunk, so that buffer and cache stay small
+                const size_t rowbytes = chunkbytes/chunkdims[0];
+                chunkdims[0] = std::max<size_t>(1,maxbufferbytes/rowbytes);
+                bufferrows = chunkdims[0];
+            }
+        }
+    }
+
     H5::DataSpace rv_dataspace(rank,dims.data(),maxdims.data());
 
     H5::DSetCreatPropList rv_prop;
     rv_prop.setChunk(rank,chunkdims.data());
-    rv_prop.setShuffle();
-    rv_prop.setDeflate(compression);
+    if (settings.shuffle) {
+        rv_prop.setShuffle();
+    }
+    if (settings.compression > 0) {
+        rv_prop.setDeflate(settings.compression);
+    }
 
-    H5::DataSet rv_dataset = _file.createDataSet( name , rv_datatype
-                                                , rv_dataspace, rv_prop);
+    /* By default, the cache holds all chunks touched by appending a row,
+     * so that they are not read back and decompressed for the next row.
+     * It is limited to maxbufferbytes, larger caches have to be requested
+     * explicitly (as they cost that much memory per dataset).
+     */
+    size_t cachebytes = settings.chunkcache;
+    if (cachebytes == 0) {
+        cachebytes = rv_datatype.getSize();
+        for (int d=0; d<rank; d++) {
+            cachebytes *= (d == 0)? chunkdims[0]
+                                  : (dims[d]+chunkdims[d]-1)/chunkdims[d]
+                                    *chunkdims[d];
+        }
+        cachebytes = std::min<size_t>(cachebytes,maxbufferbytes);
+        cachebytes = std::max<size_t>(cachebytes,1024*1024);
+    }
+    H5::DSetAccPropList rv_access;
+    rv_access.setChunkCache( H5D_CHUNK_CACHE_NSLOTS_DEFAULT, cachebytes
+                           , H5D_CHUNK_CACHE_W0_DEFAULT);
 
+    H5::DataSet rv_dataset = _file.createDataSet( name , rv_datatype
+                                                , rv_dataspace, rv_prop
+                                                , rv_access);
 
-    return DatasetInfo<rank>(rv_dataset,rv_datatype,dims);
+    return DatasetInfo<rank>( rv_dataset,rv_datatype
+                            , dims,chunkdims,settings,bufferrows);
 }
 
 H5::H5File vfps::HDF5File::_prepareFile()
 {
-    H5::H5File rv(_fname,H5F_ACC_TRUNC);
+    H5::FileAccPropList access;
+    if (_swmrinterval > 0) {
+        // SWMR needs the file format introduced with HDF5 1.10
+        access.setLibverBounds(H5F_LIBVER_LATEST,H5F_LIBVER_LATEST);
+    }
+    H5::H5File rv(_fname,H5F_ACC_TRUNC,H5::FileCreatPropList::DEFAULT,access);
 
     rv.createGroup("/BunchLength");
     rv.createGroup("/BunchPopulation");
@@ -545,6 +1624,7 @@ H5::H5File vfps::HDF5File::_prepareFile()
     rv.createGroup("/BunchProfile");
     rv.createGroup("/CSR/");
     rv.createGroup("/CSR/Intensity");
+    rv.createGroup("/CSR/IntensityPerStep");
     rv.createGroup("/CSR/Spectrum");
     rv.createGroup("/EnergyProfile");
     rv.createGroup("/EnergySpread");
@@ -109,6 +109,15 @@ vfps::ProgramOptions::ProgramOptions() :
     _programopts_file.add_options()
         ("cldev", po::value<int32_t>(&_cldevice)->default_value(1),
             "OpenCL device to use\n('-1' lists available devices)")
+        ("CLOutOfOrder", po::value<bool>(&_cloutoforder)->default_value(false),
+            "Use out-of-order OpenCL queue, so that independent "
+            "computations might overlap")
+        ("CLFusedStep", po::value<bool>(&_clfusedstep)->default_value(false),
+            "Combine energy kicks, and Fokker-Planck term with "
+            "bunch profile, to OpenCL kernels working on columns")
+        ("CLDevices", po::value<uint32_t>(&_cldevices)->default_value(1),
+            "Number of (sub-)devices to distribute the column kernels "
+            "of CLFusedStep over (other kernels use the whole device)")
         ("ForceOpenGLVersion", po::value<int>(&_glversion)->default_value(2),
             "Force OpenGL version")
         ("gui,g", po::value<bool>(&_showphasespace)->default_value(false),
@@ -118,10 +127,94 @@ vfps::ProgramOptions::ProgramOptions() :
             "name of file to safe results.")
         ("outstep,n", po::value<uint32_t>(&outsteps)->default_value(100),
             "Save results every n steps.")
+        ("OutstepMoments",
+            po::value<uint32_t>(&_outstep_moments)->default_value(0),
+            "save bunch length, energy spread, CSR intensity, etc. "
+            "every n steps (0: every outstep)")
+        ("OutstepProfiles",
+            po::value<uint32_t>(&_outstep_profiles)->default_value(0),
+            "save bunch and energy profiles every n steps (0: every outstep)")
+        ("OutstepSpectra",
+            po::value<uint32_t>(&_outstep_spectra)->default_value(0),
+            "save CSR spectra every n steps (0: every outstep)")
+        ("OutstepWake",
+            po::value<uint32_t>(&_outstep_wake)->default_value(0),
+            "save wake potential every n steps (0: every outstep)")
+        ("OutstepTracks",
+            po::value<uint32_t>(&_outstep_tracks)->default_value(0),
+            "save tracked particles every n steps (0: every outstep)")
         ("SavePhaseSpace",
             po::value<decltype(_savephasespace)>
                 (&_savephasespace)->default_value(0),
             "save every n's outstep's phase space to HDF5 file")
+        ("CSRIntensityPerStep",
+            po::value<bool>(&_csrintensity_perstep)->default_value(false),
+            "save CSR intensity every simulation step "
+            "(cheap when wake potential is computed anyway)")
+        ("CSRSpectrumFMin",
+            po::value<double>(&_csrspectrum_fmin)->default_value(0),
+            "lowest frequency (Hz) of saved CSR spectra")
+        ("CSRSpectrumFMax",
+            po::value<double>(&_csrspectrum_fmax)->default_value(0),
+            "highest frequency (Hz) of saved CSR spectra (0: no limit)")
+        ("CSRSpectrumBins",
+            po::value<uint32_t>(&_csrspectrum_bins)->default_value(0),
+            "rebin saved CSR spectra to n frequency bins "
+            "(0: save all frequencies)")
+        ("CSRSpectrumLogBins",
+            po::value<bool>(&_csrspectrum_logbins)->default_value(false),
+            "use logarithmically (instead of linearly) spaced frequency bins")
+        ("OutputBuffer",
+            po::value<uint32_t>(&_outputbuffer)->default_value(0),
+            "memory (MiB) to queue results for writing to the HDF5 file "
+            "by a background thread (0: write synchronously)")
+        ("CompressionLevel",
+            po::value<int32_t>(&_compressionlevel)->default_value(-1),
+            "deflate level for HDF5 output "
+            "(0: no compression, -1: as given by OutputProfile)")
+        ("OutputProfile",
+            po::value<std::string>(&_outputprofile)->default_value("balanced"),
+            "storage settings for HDF5 output: fast, balanced, or archive")
+        ("OutputOverrides",
+            po::value<std::string>(&_outputoverrides)->default_value(""),
+            "storage settings for single datasets, e.g. "
+            "\"PhaseSpace:compression=9,shuffle=1,chunk=1x1x128x128,cache=64;"
+            "CSR/Spectrum:compression=0\" (cache in MiB, default: "
+            "up to 8, larger caches cost that much memory per dataset)")
+        ("QuantizeOutput",
+            po::value<bool>(&_quantizeoutput)->default_value(false),
+            "save phase space and profiles as 16 bit integers "
+            "(with offset and scale for every bunch and step)")
+        ("PhaseSpaceSnapshots",
+            po::value<bool>(&_phasespacesnapshots)->default_value(false),
+            "save phase space cropped to the occupied cells "
+            "(cannot be combined with QuantizeOutput)")
+        ("SnapshotThreshold",
+            po::value<double>(&_snapshotthreshold)->default_value(0),
+            "cells below this fraction of the maximum are not saved "
+            "in phase space snapshots")
+        ("SnapshotKeyframes",
+            po::value<uint32_t>(&_snapshotkeyframes)->default_value(1),
+            "every n'th phase space snapshot is saved completely, "
+            "the others as differences to the previous one")
+        ("SWMR",
+            po::value<uint32_t>(&_swmrinterval)->default_value(0),
+            "write HDF5 file in SWMR mode, so that it can be read while "
+            "the simulation runs, flushing every n seconds (0: off)")
+        ("SharedMemory",
+            po::value<std::string>(&_sharedmemory)->default_value(""),
+            "name of POSIX shared memory (e.g. /inovesa) to publish "
+            "results of every outstep to (empty: off)")
+        ("SharedMemorySlots",
+            po::value<uint32_t>(&_sharedmemoryslots)->default_value(16),
+            "number of outsteps kept in shared memory")
+        ("SharedMemoryPhaseSpace",
+            po::value<bool>(&_sharedmemoryphasespace)->default_value(false),
+            "also publish the phase space to shared memory")
+        ("CompressionThreads",
+            po::value<uint32_t>(&_compressionthreads)->default_value(0),
+            "threads to compress HDF5 chunks before writing them directly "
+            "(0: HDF5 compresses while writing)")
         ("tracking",
             po::value<std::string>(&_trackingfile)->default_value(""),
             "file containing starting positions (grid points)"
@@ -138,6 +231,37 @@ vfps::ProgramOptions::ProgramOptions() :
         #else // not INOVESA_USE_OPENCL
             "(not active in this build)")
         #endif // INOVESA_USE_OPENCL
+        ("CLOutOfOrder", po::value<bool>(&_cloutoforder)->default_value(false)
+            ->implicit_value(true),
+        #if INOVESA_USE_OPENCL == 1
+            "Use out-of-order OpenCL queue, so that independent "
+            "computations might overlap")
+        #else // not INOVESA_USE_OPENCL
+            "(not active in this build)")
+        #endif // INOVESA_USE_OPENCL
+        ("CLFusedStep", po::value<bool>(&_clfusedstep)->default_value(false)
+            ->implicit_value(true),
+        #if INOVESA_USE_OPENCL == 1
+            "Combine energy kicks, and Fokker-Planck term with "
+            "bunch profile, to OpenCL kernels working on columns")
+        #else // not INOVESA_USE_OPENCL
+            "(not active in this build)")
+        #endif // INOVESA_USE_OPENCL
+        ("CLDevices", po::value<uint32_t>(&_cldevices)->default_value(1),
+        #if INOVESA_USE_OPENCL == 1
+            "Number of (sub-)devices to distribute the column kernels "
+            "of CLFusedStep over (other kernels use the whole device)")
+        #else // not INOVESA_USE_OPENCL
+            "(not active in this build)")
+        #endif // INOVESA_USE_OPENCL
+        ("tune", po::value<bool>(&_cltune)->default_value(false)
+            ->implicit_value(true),
+        #if INOVESA_USE_OPENCL == 1
+            "Benchmark OpenCL work-group sizes again, "
+            "even if stored results exist")
+        #else // not INOVESA_USE_OPENCL
+            "(not active in this build)")
+        #endif // INOVESA_USE_OPENCL
         ("config,c", po::value<std::string>(&_configfile),
             "name of a file containing a configuration.")
         ("ForceOpenGLVersion", po::value<int>(&_glversion)->default_value(2),
@@ -149,10 +273,99 @@ vfps::ProgramOptions::ProgramOptions() :
             "name of file to safe results.")
         ("outstep,n", po::value<uint32_t>(&outsteps)->default_value(100),
             "Save results every n steps.")
+        ("OutstepMoments",
+            po::value<uint32_t>(&_outstep_moments)->default_value(0),
+            "save bunch length, energy spread, CSR intensity, etc. "
+            "every n steps (0: every outstep)")
+        ("OutstepProfiles",
+            po::value<uint32_t>(&_outstep_profiles)->default_value(0),
+            "save bunch and energy profiles every n steps (0: every outstep)")
+        ("OutstepSpectra",
+            po::value<uint32_t>(&_outstep_spectra)->default_value(0),
+            "save CSR spectra every n steps (0: every outstep)")
+        ("OutstepWake",
+            po::value<uint32_t>(&_outstep_wake)->default_value(0),
+            "save wake potential every n steps (0: every outstep)")
+        ("OutstepTracks",
+            po::value<uint32_t>(&_outstep_tracks)->default_value(0),
+            "save tracked particles every n steps (0: every outstep)")
         ("SavePhaseSpace",
             po::value<decltype(_savephasespace)>
                 (&_savephasespace)->default_value(0),
             "save every n's outstep's phase space to HDF5 file")
+        ("CSRIntensityPerStep",
+            po::value<bool>(&_csrintensity_perstep)->default_value(false)
+                ->implicit_value(true),
+            "save CSR intensity every simulation step "
+            "(cheap when wake potential is computed anyway)")
+        ("CSRSpectrumFMin",
+            po::value<double>(&_csrspectrum_fmin)->default_value(0),
+            "lowest frequency (Hz) of saved CSR spectra")
+        ("CSRSpectrumFMax",
+            po::value<double>(&_csrspectrum_fmax)->default_value(0),
+            "highest frequency (Hz) of saved CSR spectra (0: no limit)")
+        ("CSRSpectrumBins",
+            po::value<uint32_t>(&_csrspectrum_bins)->default_value(0),
+            "rebin saved CSR spectra to n frequency bins "
+            "(0: save all frequencies)")
+        ("CSRSpectrumLogBins",
+            po::value<bool>(&_csrspectrum_logbins)->default_value(false)
+                ->implicit_value(true),
+            "use logarithmically (instead of linearly) spaced frequency bins")
+        ("OutputBuffer",
+            po::value<uint32_t>(&_outputbuffer)->default_value(0),
+            "memory (MiB) to queue results for writing to the HDF5 file "
+            "by a background thread (0: write synchronously)")
+        ("CompressionLevel",
+            po::value<int32_t>(&_compressionlevel)->default_value(-1),
+            "deflate level for HDF5 output "
+            "(0: no compression, -1: as given by OutputProfile)")
+        ("OutputProfile",
+            po::value<std::string>(&_outputprofile)->default_value("balanced"),
+            "storage settings for HDF5 output: fast, balanced, or archive")
+        ("OutputOverrides",
+            po::value<std::string>(&_outputoverrides)->default_value(""),
+            "storage settings for single datasets, e.g. "
+            "\"PhaseSpace:compression=9,shuffle=1,chunk=1x1x128x128,cache=64;"
+            "CSR/Spectrum:compression=0\" (cache in MiB, default: "
+            "up to 8, larger caches cost that much memory per dataset)")
+        ("QuantizeOutput",
+            po::value<bool>(&_quantizeoutput)->default_value(false)
+                ->implicit_value(true),
+            "save phase space and profiles as 16 bit integers "
+            "(with offset and scale for every bunch and step)")
+        ("PhaseSpaceSnapshots",
+            po::value<bool>(&_phasespacesnapshots)->default_value(false)
+                ->implicit_value(true),
+            "save phase space cropped to the occupied cells "
+            "(cannot be combined with QuantizeOutput)")
+        ("SnapshotThreshold",
+            po::value<double>(&_snapshotthreshold)->default_value(0),
+            "cells below this fraction of the maximum are not saved "
+            "in phase space snapshots")
+        ("SnapshotKeyframes",
+            po::value<uint32_t>(&_snapshotkeyframes)->default_value(1),
+            "every n'th phase space snapshot is saved completely, "
+            "the others as differences to the previous one")
+        ("SWMR",
+            po::value<uint32_t>(&_swmrinterval)->default_value(0),
+            "write HDF5 file in SWMR mode, so that it can be read while "
+            "the simulation runs, flushing every n seconds (0: off)")
+        ("SharedMemory",
+            po::value<std::string>(&_sharedmemory)->default_value(""),
+            "name of POSIX shared memory (e.g. /inovesa) to publish "
+            "results of every outstep to (empty: off)")
+        ("SharedMemorySlots",
+            po::value<uint32_t>(&_sharedmemoryslots)->default_value(16),
+            "number of outsteps kept in shared memory")
+        ("SharedMemoryPhaseSpace",
+            po::value<bool>(&_sharedmemoryphasespace)->default_value(false)
+                ->implicit_value(true),
+            "also publish the phase space to shared memory")
+        ("CompressionThreads",
+            po::value<uint32_t>(&_compressionthreads)->default_value(0),
+            "threads to compress HDF5 chunks before writing them directly "
+            "(0: HDF5 compresses while writing)")
         ("tracking",
             po::value<std::string>(&_trackingfile)->default_value(""),
             "file containing starting positions (grid points)"
@@ -170,7 +383,8 @@ vfps::ProgramOptions::ProgramOptions() :
         ("padding,p", po::value<double>(&padding)->default_value(8.0),
             "Factor for zero padding of single bunch profile(s)")
         ("RoundPadding", po::value<bool>(&roundpadding)->default_value(true),
-            "Always do zero padding up to 2 to the power of N")
+            "Round zero padding up to a size efficient for FFT "
+            "(2^a*3^b*5^c)")
         ("PhaseSpaceSize,P", po::value<double>(&pq_size)->default_value(12),
             "Size of phase space")
         ("PhaseSpaceShiftX",po::value<double>(&meshshiftx)->default_value(0),
@@ -317,6 +531,7 @@ void vfps::ProgramOptions::save(std::string fname)
         || it->first == "steps"
         || it->first == "RFVoltage"
         || it->first == "run_anyway"
+        || it->first == "tune"
         || it->first == "SaveSourceMap"
         ){
             continue;
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * This file is part of Inovesa (github.com/Inovesa/Inovesa).
+ * It's copyrighted by the contributors recorded
+ * in the version control history of the file.
+ */
+
+#include "IO/SharedMemorySink.hpp"
+
+#if INOVESA_USE_SHM == 1
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// arrays and slots start at cache line boundaries
+constexpr size_t alignment = 64;
+
+constexpr size_t align(const size_t bytes)
+{
+    return (bytes+alignment-1)/alignment*alignment;
+}
+
+} // namespace
+
+vfps::SharedMemorySink::SharedMemorySink( const std::string name
+                                        , const uint32_t nslots
+                                        , const bool phasespace)
+  : _name( name )
+  , _phasespace( phasespace )
+  , _bytes( 0 )
+  , _header( nullptr )
+  , _sequence( 0 )
+{
+    // order has to match sources in publish()
+    _addArray<projection_t>("BunchProfile",{PhaseSpace::nb,PhaseSpace::nx});
+    _addArray<projection_t>("EnergyProfile",{PhaseSpace::nb,PhaseSpace::ny});
+    _addArray<csrpower_t>("CSRIntensity",{PhaseSpace::nb});
+    if (_phasespace) {
+        _addArray<meshdata_t>("PhaseSpace",{ PhaseSpace::nb
+                                           , PhaseSpace::nx
+                                           , PhaseSpace::ny});
+    }
+
+    const uint64_t slotoffset = align( sizeof(InovesaSHMHeader)
+                                     + _arrays.size()*sizeof(InovesaSHMArray));
+    const uint64_t slotbytes = align( _arrays.back().offset
+                                    + _arrays.back().bytes);
+    const uint32_t slots = std::max(nslots,1U);
+    _bytes = slotoffset + slots*slotbytes;
+
+    const int fd = shm_open(_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not create shared memory \""
+                                 +_name+"\": "+std::strerror(errno));
+    }
+    if (ftruncate(fd,_bytes) != 0) {
+        const std::string error(std::strerror(errno));
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw std::runtime_error("Could not resize shared memory \""
+                                 +_name+"\": "+error);
+    }
+    void* mem = mmap(nullptr,_bytes,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(_name.c_str());
+        throw std::runtime_error("Could not map shared memory \""
+                                 +_name+"\": "+std::strerror(errno));
+    }
+    _header = static_cast<InovesaSHMHeader*>(mem);
+
+    _header->version = INOVESA_SHM_VERSION;
+    _header->narrays = _arrays.size();
+    _header->nslots = slots;
+    _header->slotoffset = slotoffset;
+    _header->slotbytes = slotbytes;
+    _header->sequence = 0;
+    std::copy( _arrays.begin(),_arrays.end()
+             , reinterpret_cast<InovesaSHMArray*>(_header+1));
+
+    // readers may use the header as soon as the magic number is there
+    __atomic_store_n(&_header->magic,INOVESA_SHM_MAGIC,__ATOMIC_RELEASE);
+}
+
+vfps::SharedMemorySink::~SharedMemorySink() noexcept
+{
+    munmap(_header,_bytes);
+    shm_unlink(_name.c_str());
+}
+
+void vfps::SharedMemorySink::publish( const PhaseSpace& ps
+                                    , const ElectricField* ef
+                                    , const uint64_t step
+                                    , const timeaxis_t t)
+{
+    const uint64_t n = ++_sequence;
+    char* const slotdata = reinterpret_cast<char*>(_header)
+                         + _header->slotoffset
+                         + (n-1)%_header->nslots*_header->slotbytes;
+    auto slot = reinterpret_cast<InovesaSHMSlot*>(slotdata);
+
+    // readers will notice that the slot is being changed
+    __atomic_store_n(&slot->sequence,2*n-1,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->step = step;
+    slot->time = t;
+    const void* sources[] = { ps.getProjection(0).data()
+                            , ps.getProjection(1).data()
+                            , (ef != nullptr)? ef->getCSRPower() : nullptr
+                            , ps.getData() };
+    for (size_t i=0; i<_arrays.size(); i++) {
+        if (sources[i] != nullptr) {
+            std::memcpy(slotdata+_arrays[i].offset,sources[i],_arrays[i].bytes);
+        } else {
+            std::memset(slotdata+_arrays[i].offset,0,_arrays[i].bytes);
+        }
+    }
+
+    __atomic_store_n(&slot->sequence,2*n,__ATOMIC_RELEASE);
+    __atomic_store_n(&_header->sequence,n,__ATOMIC_RELEASE);
+}
+
+template <typename datatype>
+void vfps::SharedMemorySink::_addArray( const std::string& name
+                                      , const std::vector<uint32_t>& dims)
+{
+    static_assert( std::is_same<datatype,float>::value
+                || std::is_same<datatype,double>::value
+                 , "Unsupported datatype.");
+
+    InovesaSHMArray array;
+    std::memset(&array,0,sizeof(array));
+    name.copy(array.name,INOVESA_SHM_NAMELENGTH-1);
+    array.type = std::is_same<datatype,float>::value ? INOVESA_SHM_FLOAT32
+                                                     : INOVESA_SHM_FLOAT64;
+    array.rank = dims.size();
+    std::copy(dims.begin(),dims.end(),array.dims);
+    array.offset = _arrays.empty()? align(sizeof(InovesaSHMSlot))
+                                  : align( _arrays.back().offset
+                                         + _arrays.back().bytes);
+    array.bytes = sizeof(datatype);
+    for (auto dim : dims) {
+        array.bytes *= dim;
+    }
+    _arrays.push_back(array);
+}
+
+#endif // INOVESA_USE_SHM
@@ -98,6 +98,13 @@ vfps::ElectricField::ElectricField(std::shared_ptr<PhaseSpace> ps
         _formfactor = reinterpret_cast<impedance_t*>(_formfactor_fft);
 
         _fft_bunchprofile = prepareFFT(_nmax,_bp_padded,_formfactor);
+
+        double adds, muls, fmas;
+        fftwf_flops(_fft_bunchprofile,&adds,&muls,&fmas);
+        std::stringstream sstream;
+        sstream << "... FFT size " << _nmax << ", estimated cost: "
+                << adds+muls+2*fmas << " flops";
+        Display::printText(sstream.str());
     }
 }
 
@@ -135,13 +142,13 @@ vfps::ElectricField::ElectricField( std::shared_ptr<PhaseSpace> ps
             wakepotential_clbuf = cl::Buffer( _oclh->context, CL_MEM_READ_WRITE
                                            , sizeof(*_wakepotential)*PhaseSpace::nx);
         }
-    #ifndef INOVESA_USE_CLFFT
+    #if INOVESA_USE_CLFFT != 1
     }
-    #else // defined INOVESA_USE_CLFFT
+    #else // INOVESA_USE_CLFFT
         _wakelosses = new impedance_t[_nmax];
 
         // second half is initialized because it is not touched elsewhere
-        std::fill_n(_wakelosses+_nmax/2,_nmax/2,0);
+        std::fill_n(_wakelosses+(_nmax+1)/2,_nmax/2,0);
 
 
         _wakelosses_buf = cl::Buffer(_oclh->context, CL_MEM_READ_WRITE,
@@ -301,85 +308,135 @@ vfps::csrpower_t* vfps::ElectricField::updateCSR(const frequency_t cutoff)
     if (_oclh) {
         _oclh->enqueueCopyBuffer(_phasespace->projectionX_clbuf,_bp_padded_buf,
                                 0,0,sizeof(_bp_padded[0])*PhaseSpace::nx);
-        _oclh->enqueueBarrier();
         _oclh->enqueueDFT(_clfft_bunchprofile,CLFFT_FORWARD,
                           _bp_padded_buf,_formfactor_buf);
-        _oclh->enqueueBarrier();
 
         _oclh->enqueueReadBuffer(_formfactor_buf,CL_TRUE,0,
                                 _nmax*sizeof(*_formfactor),_formfactor);
     }
-    #elif INOVESA_USE_OPENCL == 1
-    if (_oclh) {
-        _phasespace->syncCLMem(OCLH::clCopyDirection::dev2cpu);
-    }
-    #endif // INOVESA_USE_CLTTT
+    #endif // INOVESA_USE_CLFFT
         for (uint32_t n = 0; n < _nbunches; n++) {
-        #if INOVESA_USE_OPENCL == 1
+        #if INOVESA_USE_CLFFT == 1
         if (!_oclh)
-        #endif // INOVESA_USE_OPENCL
+        #endif // INOVESA_USE_CLFFT
         {
             // copy bunch profile to be padded
-            const vfps::projection_t* bp = _phasespace->getProjection(0)[n];
-            std::copy_n(bp,PhaseSpace::nx,_bp_padded);
+            _copyBunchProfile(n,_bp_padded);
 
             //FFT charge density
             fft_execute(_fft_bunchprofile);
         }
-        _csrintensity[n] = 0;
+        _spectrumFromFormFactor(n,cutoff);
+    }
 
-        for (unsigned int i=0; i<_nmax; i++) {
-            frequency_t renorm(_formfactorrenorm);
-            if (cutoff > 0) {
-                renorm *= (1-std::exp(-std::pow((_axis_freq.scale("Hertz")*_axis_freq[i]/cutoff),2)));
-            }
+    return _csrspectrum.data();
+}
 
-            // norm = squared magnitude
-            _csrspectrum[n][i] = renorm * ((*_impedance)[i]).real()
-                               * std::norm(_formfactor[i]);
+vfps::csrpower_t*
+vfps::ElectricField::updateCSR( const ElectricField& source
+                              , const frequency_t cutoff)
+{
+    if (_nbunches != 1 || &source == this) {
+        return updateCSR(cutoff);
+    }
 
-            _csrintensity[n] += _axis_freq.delta()*_csrspectrum[n][i];
+    const impedance_t* ff = source._formfactor;
+    #if INOVESA_USE_CLFFT == 1
+    std::vector<impedance_t> ff_dev;
+    if (source._oclh) {
+        ff_dev.resize(source._nmax);
+        _oclh->enqueueReadBuffer(source._formfactor_buf,CL_TRUE,0,
+                                 source._nmax*sizeof(impedance_t),
+                                 ff_dev.data());
+        ff = ff_dev.data();
+    }
+    #endif // INOVESA_USE_CLFFT
+
+    if (source._nmax == _nmax) {
+        std::copy_n(ff,_nmax,_formfactor);
+    } else {
+        /* Only the lower half of the source form factor is valid (R2C FFT).
+         * As the spectrum only needs the squared magnitude,
+         * that one is interpolated, which is insensitive to the phase
+         * that depends on the bunch position in the padded profile.
+         */
+        const double ratio = static_cast<double>(source._nmax)/_nmax;
+        const size_t maxsrc = source._nmax/2;
+        for (size_t i=0; i<_nmax; i++) {
+            const double pos = i*ratio;
+            const size_t lo = static_cast<size_t>(pos);
+            if (lo < maxsrc) {
+                const csrpower_t w = pos-lo;
+                const csrpower_t mag2 = (1-w)*std::norm(ff[lo])
+                                      + w*std::norm(ff[lo+1]);
+                _formfactor[i] = impedance_t(std::sqrt(mag2),0);
+            } else {
+                _formfactor[i] = impedance_t(0,0);
+            }
         }
     }
+    _spectrumFromFormFactor(0,cutoff);
 
     return _csrspectrum.data();
 }
 
+void vfps::ElectricField::_spectrumFromFormFactor( const uint32_t n
+                                                 , const frequency_t cutoff)
+{
+    _csrintensity[n] = 0;
+
+    for (unsigned int i=0; i<_nmax; i++) {
+        frequency_t renorm(_formfactorrenorm);
+        if (cutoff > 0) {
+            renorm *= (1-std::exp(-std::pow((_axis_freq.scale("Hertz")*_axis_freq[i]/cutoff),2)));
+        }
+
+        // norm = squared magnitude
+        _csrspectrum[n][i] = renorm * ((*_impedance)[i]).real()
+                           * std::norm(_formfactor[i]);
+
+        _csrintensity[n] += _axis_freq.delta()*_csrspectrum[n][i];
+    }
+}
+
 vfps::meshaxis_t *vfps::ElectricField::wakePotential()
 {
     #if INOVESA_USE_CLFFT == 1
     if (_oclh){
+        // copy and DFTs declare their buffers implicitly
         _oclh->enqueueCopyBuffer(_phasespace->projectionX_clbuf,_bp_padded_buf,
                                 0,0,sizeof(*_bp_padded)*PhaseSpace::nx);
-        _oclh->enqueueBarrier();
         _oclh->enqueueDFT(_clfft_bunchprofile,CLFFT_FORWARD,
                          _bp_padded_buf,_formfactor_buf);
-        _oclh->enqueueBarrier();
 
-        _oclh->enqueueNDRangeKernel( _clKernWakelosses,cl::NullRange,
-                                          cl::NDRange(_nmax));
-        _oclh->enqueueBarrier();
+        const cl::NDRange global(_nmax);
+        const OCLH::Access wlaccess{{_impedance->data_buf,_formfactor_buf}
+                                   , {_wakelosses_buf}};
+        _oclh->enqueueNDRangeKernel( wlaccess
+                                   , _clKernWakelosses,cl::NullRange
+                                   , global
+                                   , _oclh->localSize( wlaccess
+                                                     , _clKernWakelosses
+                                                     , global));
         _oclh->enqueueDFT(_clfft_wakelosses,CLFFT_BACKWARD,
                          _wakelosses_buf,_wakepotential_padded_buf);
-        _oclh->enqueueBarrier();
-        _oclh->enqueueNDRangeKernel( _clKernScaleWP,cl::NullRange,
-                                          cl::NDRange(_nmax));
-        _oclh->enqueueBarrier();
+        const OCLH::Access wpaccess{{_wakepotential_padded_buf}
+                                   , {wakepotential_clbuf}};
+        _oclh->enqueueNDRangeKernel( wpaccess
+                                   , _clKernScaleWP,cl::NullRange
+                                   , global
+                                   , _oclh->localSize( wpaccess
+                                                     , _clKernScaleWP
+                                                     , global));
         #if INOVESA_SYNC_CL == 1
         syncCLMem(OCLH::clCopyDirection::dev2cpu);
         #endif // INOVESA_SYNC_CL
     } else
-    #elif INOVESA_USE_OPENCL == 1
-    if (_oclh) {
-        _phasespace->syncCLMem(OCLH::clCopyDirection::dev2cpu);
-    }
-    #endif // INOVESA_USE_OPENCL
+    #endif // INOVESA_USE_CLFFT
     {
         // copy bunch profiles to have correct padding
-        const vfps::projection_t* bp= _phasespace->getProjection(0);
         for (uint32_t b=0; b<PhaseSpace::nb; b++) {
-            std::copy_n( bp+b*PhaseSpace::nx
-                       , PhaseSpace::nx,_bp_padded+_bucket[b]*_spacing_bins);
+            _copyBunchProfile(b,_bp_padded+_bucket[b]*_spacing_bins);
         }
 
         /* Fourier transorm bunch profile (_bp_padded),
@@ -393,7 +450,8 @@ vfps::meshaxis_t *vfps::ElectricField::wakePotential()
          */
         fft_execute(_fft_bunchprofile);
 
-        for (unsigned int i=0; i<_nmax/2; i++) {
+        // (_nmax+1)/2 also covers the last frequency for odd FFT sizes
+        for (unsigned int i=0; i<(_nmax+1)/2; i++) {
             _wakelosses[i]= (*_impedance)[i] *_formfactor[i];
         }
 
@@ -407,51 +465,71 @@ vfps::meshaxis_t *vfps::ElectricField::wakePotential()
             }
         }
         #if INOVESA_USE_OPENCL == 1
-        #ifndef INOVESA_USE_CLFFT
         if (_oclh) {
-            _oclh->enqueueWriteBuffer(wakepotential_clbuf,CL_TRUE,0,
-                                     sizeof(*_wakepotential)*PhaseSpace::nx,
-                                     _wakepotential);
+            // kernels using the wake potential are enqueued after this
+            _oclh->enqueueUpload( wakepotential_clbuf
+                                , sizeof(*_wakepotential)*PhaseSpace::nx
+                                , _wakepotential);
         }
-        #endif // INOVESA_USE_CLFFT
         #endif // INOVESA_USE_OPENCL
     }
     return _wakepotential;
 }
 
+void vfps::ElectricField::_copyBunchProfile( const uint32_t n
+                                           , integral_t* dst) const
+{
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh) {
+        /* Without clFFT, the FFT is done on the host.
+         * Reading only the bunch profile is much cheaper than
+         * synchronizing the full phase space.
+         */
+        _oclh->enqueueReadBuffer( _phasespace->projectionX_clbuf,CL_TRUE
+                                , n*PhaseSpace::nx*sizeof(projection_t)
+                                , PhaseSpace::nx*sizeof(projection_t)
+                                , dst);
+        return;
+    }
+    #endif // INOVESA_USE_OPENCL
+    const vfps::projection_t* bp = _phasespace->getProjection(0)[n];
+    std::copy_n(bp,PhaseSpace::nx,dst);
+}
+
 #if INOVESA_USE_OPENCL == 1
 void vfps::ElectricField::syncCLMem(OCLH::clCopyDirection dir)
 {
     if (_oclh) {
     switch (dir) {
     case OCLH::clCopyDirection::cpu2dev:
+        // without clFFT, only the wake potential is used on the device
+        #if INOVESA_USE_CLFFT == 1
         _oclh->enqueueWriteBuffer(_bp_padded_buf,CL_TRUE,0,
                                        sizeof(*_bp_padded)*_nmax,_bp_padded);
         _oclh->enqueueWriteBuffer(_formfactor_buf,CL_TRUE,0,
                                        sizeof(*_formfactor)*_nmax,_formfactor);
-        #if INOVESA_USE_CLFFT == 1
         _oclh->enqueueWriteBuffer(_wakelosses_buf,CL_TRUE,0,
                                        sizeof(*_wakelosses)*_nmax,_wakelosses);
-        #endif // INOVESA_USE_CLFFT
         _oclh->enqueueWriteBuffer(_wakepotential_padded_buf,CL_TRUE,0,
                                        sizeof(*_wakepotential_padded)*_nmax,
                                        _wakepotential_padded);
+        #endif // INOVESA_USE_CLFFT
         _oclh->enqueueWriteBuffer(wakepotential_clbuf,CL_TRUE,0,
                                        sizeof(*_wakepotential)*PhaseSpace::nx,
                                        _wakepotential);
         break;
     case OCLH::clCopyDirection::dev2cpu:
+        #if INOVESA_USE_CLFFT == 1
         _oclh->enqueueReadBuffer(_bp_padded_buf,CL_TRUE,0,
                                       sizeof(*_bp_padded)*_nmax,_bp_padded);
         _oclh->enqueueReadBuffer(_formfactor_buf,CL_TRUE,0,
                                       sizeof(*_formfactor)*_nmax,_formfactor);
-        #if INOVESA_USE_CLFFT == 1
         _oclh->enqueueReadBuffer(_wakelosses_buf,CL_TRUE,0,
                                       sizeof(*_wakelosses)*_nmax,_wakelosses);
-        #endif // INOVESA_USE_CLFFT
         _oclh->enqueueReadBuffer(_wakepotential_padded_buf,CL_TRUE,0,
                                       sizeof(*_wakepotential_padded)*_nmax,
                                       _wakepotential_padded);
+        #endif // INOVESA_USE_CLFFT
         _oclh->enqueueReadBuffer(wakepotential_clbuf,CL_TRUE,0,
                                       sizeof(*_wakepotential)*PhaseSpace::nx,
                                       _wakepotential);
@@ -459,6 +537,21 @@ void vfps::ElectricField::syncCLMem(OCLH::clCopyDirection dir)
     }
     }
 }
+
+void vfps::ElectricField::downloadPadded()
+{
+    #if INOVESA_USE_CLFFT == 1
+    if (_oclh) {
+        _oclh->enqueueDownload( _bp_padded_buf
+                              , sizeof(*_bp_padded)*_nmax
+                              , _bp_padded);
+        _oclh->enqueueDownload( _wakepotential_padded_buf
+                              , sizeof(*_wakepotential_padded)*_nmax
+                              , _wakepotential_padded);
+    }
+    #endif // INOVESA_USE_CLFFT
+    // without clFFT, the padded arrays are computed on the host
+}
 #endif // INOVESA_USE_OPENCL
 
 vfps::fft_complex* vfps::ElectricField::fft_alloc_complex(size_t n)
@@ -70,13 +70,13 @@ vfps::PhaseSpace::PhaseSpace( std::array<meshRuler_ptr, 2> axis
         data_buf = cl::Buffer(_oclh->context,
                             CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
                             sizeof(meshdata_t)*_nbunches*_nmeshcellsX*_nmeshcellsY,
-                           _data());
+                           _data.data());
         #if INOVESA_USE_OPENGL == 1
         if (_oclh->OpenGLSharing()) {
             glGenBuffers(1, &projectionX_glbuf);
             glBindBuffer(GL_ARRAY_BUFFER,projectionX_glbuf);
             glBufferData( GL_ARRAY_BUFFER
-                        , _nmeshcellsX*sizeof(decltype(_projection)::value_type)
+                        , _nbunches*_nmeshcellsX*sizeof(projection_t)
                         , 0, GL_DYNAMIC_DRAW);
             projectionX_clbuf = cl::BufferGL( _oclh->context,CL_MEM_READ_WRITE
                                             , projectionX_glbuf);
@@ -86,13 +86,34 @@ vfps::PhaseSpace::PhaseSpace( std::array<meshRuler_ptr, 2> axis
             projectionX_clbuf = cl::Buffer(
                         _oclh->context,
                         CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-                        _nmeshcellsX*sizeof(decltype(_projection)::value_type),
-                        _projection[0].data());
+                        _nbunches*_nmeshcellsX*sizeof(projection_t),
+                        _projection[0]);
         }
+        projectionY_clbuf = cl::Buffer( _oclh->context
+                                      , CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR
+                                      , _nbunches*_nmeshcellsY*sizeof(projection_t)
+                                      , _projection[1]);
         bunchpop_buf = cl::Buffer( _oclh->context
                                  , CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR
                                  , _nbunches*sizeof(integral_t)
-                                 , _bunchpopulation.data());
+                                 , _filling.data());
+        fillingset_buf = cl::Buffer( _oclh->context
+                                   , CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR
+                                   , _nbunches*sizeof(integral_t)
+                                   , const_cast<integral_t*>(_filling_set.data()));
+        for (uint_fast8_t axis=0; axis<2; axis++) {
+            std::vector<meshaxis_t> qp(nMeshCells(axis));
+            for (meshindex_t i=0; i<qp.size(); i++) {
+                qp[i] = _qp(axis,i);
+            }
+            _axis_buf[axis] = cl::Buffer( _oclh->context
+                                        , CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR
+                                        , qp.size()*sizeof(meshaxis_t)
+                                        , qp.data());
+            _momentsums_buf[axis] = cl::Buffer( _oclh->context
+                                              , CL_MEM_READ_WRITE
+                                              , 4*_nbunches*sizeof(integral_t));
+        }
         ws_buf = cl::Buffer(_oclh->context,
                             CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
                             sizeof(decltype(_ws)::value_type)*_nmeshcellsX,
@@ -105,12 +126,53 @@ vfps::PhaseSpace::PhaseSpace( std::array<meshRuler_ptr, 2> axis
         _clKernProjX.setArg(2, _nmeshcellsY);
         _clKernProjX.setArg(3, projectionX_clbuf);
 
-        _clProgIntegral = _oclh->prepareCLProg(cl_code_integral);
-        _clKernIntegral = cl::Kernel(_clProgIntegral, "integral");
+        _clProgReduce = _oclh->prepareCLProg(cl_code_reductions);
+        _clKernIntegral = cl::Kernel(_clProgReduce, "integral");
+        _clKernProjY = cl::Kernel(_clProgReduce, "projectionY");
+        _clKernNormalize = cl::Kernel(_clProgReduce, "normalize");
+        for (uint_fast8_t axis=0; axis<2; axis++) {
+            _clKernMoments[axis] = cl::Kernel(_clProgReduce, "moments");
+        }
+
+        // largest power of two (up to 256) all reduction kernels support
+        size_t maxsize = 256;
+        for (const auto& kernel : _clKernMoments) {
+            maxsize = std::min(maxsize,_oclh->maxWorkGroupSize(kernel));
+        }
+        maxsize = std::min(maxsize,_oclh->maxWorkGroupSize(_clKernIntegral));
+        _clReduceSize = 1;
+        while (2*_clReduceSize <= maxsize) {
+            _clReduceSize *= 2;
+        }
+
         _clKernIntegral.setArg(0, projectionX_clbuf);
         _clKernIntegral.setArg(1, ws_buf);
         _clKernIntegral.setArg(2, _nmeshcellsX);
-        _clKernIntegral.setArg(3, bunchpop_buf);
+        _clKernIntegral.setArg(3, cl::Local(_clReduceSize*sizeof(integral_t)));
+        _clKernIntegral.setArg(4, bunchpop_buf);
+
+        _clKernProjY.setArg(0, data_buf);
+        _clKernProjY.setArg(1, ws_buf);
+        _clKernProjY.setArg(2, _nmeshcellsX);
+        _clKernProjY.setArg(3, _nmeshcellsY);
+        _clKernProjY.setArg(4, projectionY_clbuf);
+
+        _clKernMoments[0].setArg(0, projectionX_clbuf);
+        _clKernMoments[1].setArg(0, projectionY_clbuf);
+        for (uint_fast8_t axis=0; axis<2; axis++) {
+            _clKernMoments[axis].setArg(1, _axis_buf[axis]);
+            _clKernMoments[axis].setArg(2, nMeshCells(axis));
+            _clKernMoments[axis].setArg(3, getDelta(axis));
+            _clKernMoments[axis].setArg(4, bunchpop_buf);
+            _clKernMoments[axis].setArg(5, cl::Local(4*_clReduceSize
+                                                     *sizeof(integral_t)));
+            _clKernMoments[axis].setArg(6, _momentsums_buf[axis]);
+        }
+
+        _clKernNormalize.setArg(0, data_buf);
+        _clKernNormalize.setArg(1, _nmeshcells);
+        _clKernNormalize.setArg(2, fillingset_buf);
+        _clKernNormalize.setArg(3, bunchpop_buf);
     } catch (cl::Error &e) {
         std::cerr << "Error: " << e.what() << std::endl
                   << "Shutting down OpenCL." << std::endl;
@@ -187,11 +249,12 @@ void vfps::PhaseSpace::integrate()
 {
     #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
-        _oclh->enqueueNDRangeKernel( _clKernIntegral
+        _oclh->enqueueNDRangeKernel( {{projectionX_clbuf,ws_buf},{bunchpop_buf}}
+                                  , _clKernIntegral
                                   , cl::NullRange
-                                  , cl::NDRange(1)
+                                  , cl::NDRange(_clReduceSize,_nbunches)
+                                  , cl::NDRange(_clReduceSize,1)
                                   #if INOVESA_ENABLE_CLPROFILING == 1
-                                  , cl::NullRange
                                   , nullptr
                                   , nullptr
                                   , integEvents.get()
@@ -214,15 +277,46 @@ void vfps::PhaseSpace::integrate()
 
 void vfps::PhaseSpace::average(const uint_fast8_t axis)
 {
-    if (axis == 0) {
-        #if INOVESA_USE_OPENCL == 1
-        if (_oclh) {
-        _oclh->enqueueReadBuffer( projectionX_clbuf,CL_TRUE,0
-                                , sizeof(projection_t)*_nmeshcellsX
-                                , _projection[0]);
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh) {
+        _oclh->enqueueNDRangeKernel( {{ axis==0?projectionX_clbuf:projectionY_clbuf
+                                      , _axis_buf[axis], bunchpop_buf}
+                                    , {_momentsums_buf[axis]}}
+                                  , _clKernMoments[axis]
+                                  , cl::NullRange
+                                  , cl::NDRange(_clReduceSize,_nbunches)
+                                  , cl::NDRange(_clReduceSize,1));
+        std::vector<integral_t> sums(4*_nbunches);
+        /* blocking, as out-of-order queues do not order this
+         * before the (blocking) read of bunchpop_buf
+         */
+        _oclh->enqueueReadBuffer( _momentsums_buf[axis],CL_TRUE,0
+                                , sizeof(integral_t)*sums.size()
+                                , sums.data());
+        _oclh->enqueueReadBuffer( bunchpop_buf,CL_TRUE,0
+                                , sizeof(integral_t)*_nbunches
+                                , _filling.data());
+        _integral = std::accumulate( _filling.begin()
+                                   , _filling.end()
+                                   , static_cast<integral_t>(0));
+        for (meshindex_t n=0; n<_nbunches; n++) {
+            std::array<meshdata_t,4> r {{0,0,0,0}};
+            if (_filling_set[n] > 0) {
+                for (uint_fast8_t k=0; k<4; k++) {
+                    // _projection is normalized in p/q coordinates
+                    r[k] = sums[4*n+k]*getDelta(axis)/_filling[n];
+                }
+            }
+            const meshdata_t var = r[1];
+            _moment[axis][0][n] = r[0];
+            _moment[axis][1][n] = var;
+            _moment[axis][2][n] = (var > 0)? r[2]/std::pow(var,1.5f) : 0;
+            _moment[axis][3][n] = (var > 0)? r[3]/(var*var) : 0;
+            _rms[axis][n] = std::sqrt(var);
         }
-        #endif
+        return;
     }
+    #endif // INOVESA_USE_OPENCL
     const meshindex_t maxi = (axis==0)? _nmeshcellsX : _nmeshcellsY;
     for (meshindex_t n=0; n<_nbunches; n++) {
         integral_t avg = 0;
@@ -242,20 +336,34 @@ void vfps::PhaseSpace::average(const uint_fast8_t axis)
 void vfps::PhaseSpace::variance(const uint_fast8_t axis)
 {
     average(axis);
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh) {
+        // all moments are already known
+        return;
+    }
+    #endif // INOVESA_USE_OPENCL
     const meshindex_t maxi = (axis==0)? _nmeshcellsX : _nmeshcellsY;
     for (meshindex_t n=0; n<_nbunches; n++) {
         meshdata_t var = 0;
+        meshdata_t m3 = 0;
+        meshdata_t m4 = 0;
         if (_filling_set[n] > 0) {
             for (size_t i=0; i<maxi; i++) {
-                var += _projection[axis][n][i]*std::pow(_qp(axis,i)
-                                                        -_moment[axis][0][n],2);
+                const meshaxis_t d = _qp(axis,i)-_moment[axis][0][n];
+                var += _projection[axis][n][i]*std::pow(d,2);
+                m3 += _projection[axis][n][i]*std::pow(d,3);
+                m4 += _projection[axis][n][i]*std::pow(d,4);
             }
 
             // _projection is normalized in p/q coordinates
             var *= getDelta(axis)/_filling[n];
+            m3 *= getDelta(axis)/_filling[n];
+            m4 *= getDelta(axis)/_filling[n];
         }
 
         _moment[axis][1][n] = var;
+        _moment[axis][2][n] = (var > 0)? m3/std::pow(var,1.5f) : 0;
+        _moment[axis][3][n] = (var > 0)? m4/(var*var) : 0;
         _rms[axis][n] = std::sqrt(var);
     }
 }
@@ -263,21 +371,23 @@ void vfps::PhaseSpace::variance(const uint_fast8_t axis)
 void vfps::PhaseSpace::updateXProjection() {
 #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
-        _oclh->enqueueNDRangeKernel(_clKernProjX
+        const OCLH::Access access{{data_buf,ws_buf},{projectionX_clbuf}};
+        const cl::NDRange global(_nbunches*_nmeshcellsX);
+        _oclh->enqueueNDRangeKernel( access
+                                  , _clKernProjX
                                   , cl::NullRange
-                                  , cl::NDRange(_nmeshcellsX)
+                                  , global
+                                  , _oclh->localSize(access,_clKernProjX,global)
                                   # if INOVESA_ENABLE_CLPROFILING == 1
-                                  , cl::NullRange
                                   , nullptr
                                   , nullptr
                                   , xProjEvents.get()
                                   #endif // INOVESA_ENABLE_CLPROFILING
                                   );
-        _oclh->enqueueBarrier();
         #if INOVESA_SYNC_CL == 1
-        _oclh->enqueueReadBuffer(projectionX_buf,CL_TRUE,0,
-                                      sizeof(projection_t)*_nmeshcellsX,
-                                      _projection[0].data());
+        _oclh->enqueueReadBuffer(projectionX_clbuf,CL_TRUE,0,
+                                      sizeof(projection_t)*_nbunches*_nmeshcellsX,
+                                      _projection[0]);
         #endif
     } else
     #endif
@@ -297,8 +407,14 @@ void vfps::PhaseSpace::updateXProjection() {
 void vfps::PhaseSpace::updateYProjection() {
     #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
-        _oclh->enqueueReadBuffer
-            (data_buf,CL_TRUE,0,sizeof(meshdata_t)*_nmeshcells,_data());
+        const OCLH::Access access{{data_buf,ws_buf},{projectionY_clbuf}};
+        const cl::NDRange global(_nmeshcellsY,_nbunches);
+        _oclh->enqueueNDRangeKernel( access
+                                  , _clKernProjY
+                                  , cl::NullRange
+                                  , global
+                                  , _oclh->localSize(access,_clKernProjY,global));
+        return;
     }
     #endif
     for (size_t n=0; n < _nbunches; n++) {
@@ -314,7 +430,13 @@ void vfps::PhaseSpace::updateYProjection() {
 const std::vector<vfps::integral_t>& vfps::PhaseSpace::normalize()
 {
     #if INOVESA_USE_OPENCL == 1
-    syncCLMem(OCLH::clCopyDirection::dev2cpu);
+    if (_oclh) {
+        _oclh->enqueueNDRangeKernel( {{bunchpop_buf,fillingset_buf},{data_buf}}
+                                  , _clKernNormalize
+                                  , cl::NullRange
+                                  , cl::NDRange(_nmeshcells,_nbunches));
+        return _filling;
+    }
     #endif // INOVESA_USE_OPENCL
 
     for (size_t n=0; n < _nbunches; n++) {
@@ -333,13 +455,6 @@ const std::vector<vfps::integral_t>& vfps::PhaseSpace::normalize()
         }
     }
 
-    #if INOVESA_USE_OPENCL == 1
-    if (_oclh) {
-        _oclh->enqueueWriteBuffer
-            (data_buf,CL_TRUE,0,
-             sizeof(meshdata_t)*_nmeshcells,_data());
-    }
-    #endif // INOVESA_USE_OPENCL
     return _filling;
 }
 
@@ -357,16 +472,19 @@ void vfps::PhaseSpace::syncCLMem(OCLH::clCopyDirection dir,cl::Event* evt)
     case OCLH::clCopyDirection::cpu2dev:
         _oclh->enqueueWriteBuffer
             (data_buf,CL_TRUE,0,
-             sizeof(meshdata_t)*_nmeshcells,_data(),nullptr,evt);
+             sizeof(meshdata_t)*_totalmeshcells,_data.data(),nullptr,evt);
         break;
     case OCLH::clCopyDirection::dev2cpu:
         _oclh->enqueueReadBuffer
-            (data_buf,CL_TRUE,0,sizeof(meshdata_t)*_nmeshcells,_data());
+            (data_buf,CL_TRUE,0,sizeof(meshdata_t)*_totalmeshcells,_data.data());
         _oclh->enqueueReadBuffer( projectionX_clbuf,CL_TRUE,0
-                                , sizeof(projection_t)*_nmeshcellsX
+                                , sizeof(projection_t)*_nbunches*_nmeshcellsX
                                 , _projection[0],nullptr,evt);
+        _oclh->enqueueReadBuffer( projectionY_clbuf,CL_TRUE,0
+                                , sizeof(projection_t)*_nbunches*_nmeshcellsY
+                                , _projection[1],nullptr,evt);
         _oclh->enqueueReadBuffer
-            (bunchpop_buf,CL_TRUE,0,sizeof(integral_t),&_bunchpopulation,
+            (bunchpop_buf,CL_TRUE,0,sizeof(integral_t)*_nbunches,_filling.data(),
             nullptr,evt
             #if INOVESA_ENABLE_CLPROFILING == 1
             , syncPSEvents.get()
@@ -376,6 +494,25 @@ void vfps::PhaseSpace::syncCLMem(OCLH::clCopyDirection dir,cl::Event* evt)
     }
     }
 }
+
+void vfps::PhaseSpace::download(const bool withdata, const bool withprojections)
+{
+    if (_oclh) {
+        if (withdata) {
+            _oclh->enqueueDownload( data_buf
+                                  , sizeof(meshdata_t)*_totalmeshcells
+                                  , _data.data());
+        }
+        if (withprojections) {
+            _oclh->enqueueDownload( projectionX_clbuf
+                                  , sizeof(projection_t)*_nbunches*_nmeshcellsX
+                                  , _projection[0]);
+            _oclh->enqueueDownload( projectionY_clbuf
+                                  , sizeof(projection_t)*_nbunches*_nmeshcellsY
+                                  , _projection[1]);
+        }
+    }
+}
 #endif // INOVESA_USE_OPENCL
 
 const vfps::meshindex_t& vfps::PhaseSpace::nx = vfps::PhaseSpace::_nmeshcellsX;
@@ -466,17 +603,112 @@ void vfps::PhaseSpace::swap(vfps::PhaseSpace& other) noexcept
 }
 
 #if INOVESA_USE_OPENCL == 1
-std::string vfps::PhaseSpace::cl_code_integral = R"(
-    __kernel void integral(const __global float* proj,
-                           const __global float* ws,
+/* Reductions use one work-group (of power of two size) per bunch:
+ * Every work-item sums up a strided part, partial sums are then
+ * combined as a binary tree in local memory.
+ */
+std::string vfps::PhaseSpace::cl_code_reductions = R"(
+    __kernel void integral(const __global data_t* proj,
+                           const __global data_t* ws,
                            const uint xsize,
-                           __global float* result)
+                           __local data_t* partial,
+                           __global data_t* result)
     {
-        float value = 0;
+        const uint l = get_local_id(0);
+        const uint n = get_group_id(1);
+        data_t value = 0;
+        for (uint x=l; x< xsize; x+=get_local_size(0)) {
+            value += proj[n*xsize+x]*ws[x];
+        }
+        partial[l] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (uint s=get_local_size(0)/2; s>0; s/=2) {
+            if (l < s) {
+                partial[l] += partial[l+s];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (l == 0) {
+            result[n] = partial[0];
+        }
+    }
+
+    /* Two passes: the mean is known before central moments are summed up,
+     * avoiding cancellation (and so matching the CPU implementation).
+     * Results are sum(proj*q) and sum(proj*(q-mean)^k) for k=2..4.
+     */
+    __kernel void moments(const __global data_t* proj,
+                          const __global data_t* axis,
+                          const uint size,
+                          const data_t delta,
+                          const __global data_t* filling,
+                          __local data4_t* partial,
+                          __global data_t* result)
+    {
+        const uint l = get_local_id(0);
+        const uint n = get_group_id(1);
+        data4_t value = (data4_t)(0);
+        for (uint i=l; i< size; i+=get_local_size(0)) {
+            value.x += proj[n*size+i]*axis[i];
+        }
+        partial[l] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (uint s=get_local_size(0)/2; s>0; s/=2) {
+            if (l < s) {
+                partial[l] += partial[l+s];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        const data_t sum = partial[0].x;
+        const data_t mean = (filling[n] != 0)? sum*delta/filling[n] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        value = (data4_t)(0);
+        for (uint i=l; i< size; i+=get_local_size(0)) {
+            const data_t d = axis[i]-mean;
+            const data_t pd2 = proj[n*size+i]*d*d;
+            value += (data4_t)(0, pd2, pd2*d, pd2*d*d);
+        }
+        partial[l] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (uint s=get_local_size(0)/2; s>0; s/=2) {
+            if (l < s) {
+                partial[l] += partial[l+s];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (l == 0) {
+            value = partial[0];
+            value.x = sum;
+            vstore4(value,n,result);
+        }
+    }
+
+    __kernel void projectionY(const __global data_t* mesh,
+                              const __global data_t* ws,
+                              const uint xsize,
+                              const uint ysize,
+                              __global data_t* proj)
+    {
+        const uint y = get_global_id(0);
+        const uint n = get_global_id(1);
+        const __global data_t* bunch = mesh + n*xsize*ysize;
+        data_t value = 0;
         for (uint x=0; x< xsize; x++) {
-            value += proj[x]*ws[x];
+            value += bunch[x*ysize+y]*ws[x];
         }
-        *result = value;
+        proj[n*ysize+y] = value;
+    }
+
+    __kernel void normalize(__global data_t* mesh,
+                            const uint nxy,
+                            const __global data_t* filling_set,
+                            const __global data_t* filling)
+    {
+        const uint i = get_global_id(0);
+        const uint n = get_global_id(1);
+        mesh[n*nxy+i] = (filling_set[n] > 0)
+                      ? mesh[n*nxy+i]*(filling_set[n]/filling[n]) : 0;
     }
     )";
 
@@ -8,6 +8,7 @@
 #include "SM/DynamicRFKickMap.hpp"
 
 #include <cmath>
+#include <random>
 
 #include <boost/math/constants/constants.hpp>
 using boost::math::constants::two_pi;
@@ -23,7 +24,6 @@ vfps::DynamicRFKickMap::DynamicRFKickMap(std::shared_ptr<PhaseSpace> in
                                         , const meshaxis_t amplspread
                                         , const meshaxis_t modampl
                                         , const double modtimeincrement
-                                        , const uint32_t steps
                                         , const InterpolationType it
                                         , const bool interpol_clamp
                                         , oclhptr_t oclh
@@ -33,9 +33,9 @@ vfps::DynamicRFKickMap::DynamicRFKickMap(std::shared_ptr<PhaseSpace> in
   , _amplnoise(amplspread/std::sqrt(revolutionpart))
   , _modampl(modampl)
   , _modtimedelta(two_pi<double>()*modtimeincrement)
-  , _prng(std::mt19937(std::random_device{}()))
-  , _dist(std::normal_distribution<meshaxis_t>(0, 1))
-  , _next_modulation(__calcModulation(steps))
+  , _seed((static_cast<uint64_t>(std::random_device{}()) << 32)
+          | std::random_device{}())
+  , _step(0)
 {
 }
 
@@ -51,7 +51,6 @@ vfps::DynamicRFKickMap::DynamicRFKickMap( std::shared_ptr<PhaseSpace> in
                                         , const meshaxis_t amplspread
                                         , const meshaxis_t modampl
                                         , const double modtimeincrement
-                                        , const uint32_t steps
                                         , const InterpolationType it
                                         , const bool interpol_clamp
                                         , oclhptr_t oclh
@@ -62,9 +61,9 @@ vfps::DynamicRFKickMap::DynamicRFKickMap( std::shared_ptr<PhaseSpace> in
   , _amplnoise(amplspread/std::sqrt(revolutionpart))
   , _modampl(modampl)
   , _modtimedelta(two_pi<double>()*modtimeincrement)
-  , _prng(std::mt19937(std::random_device{}()))
-  , _dist(std::normal_distribution<meshaxis_t>(0, 1))
-  , _next_modulation(__calcModulation(steps))
+  , _seed((static_cast<uint64_t>(std::random_device{}()) << 32)
+          | std::random_device{}())
+  , _step(0)
 {
 }
 
@@ -77,36 +76,45 @@ vfps::DynamicRFKickMap::~DynamicRFKickMap() noexcept
 = default;
 #endif // INOVESA_ENABLE_CLPROFILING
 
-std::queue<std::array<vfps::meshaxis_t,2>>
-vfps::DynamicRFKickMap::__calcModulation(uint32_t steps)
+vfps::meshaxis_t
+vfps::DynamicRFKickMap::_normal( const uint64_t counter
+                               , const uint64_t stream) const
 {
-    std::queue<std::array<meshaxis_t,2>> rv;
+    // splitmix64 finalizer applied to (seed, counter, stream)
+    uint64_t z = _seed + (2*counter+stream+1)*UINT64_C(0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    z ^= (z >> 31);
 
-    for (uint32_t i=0; i<steps; i++) {
-        meshaxis_t phasenoise = _dist(_prng)*_phasenoise;
-        meshaxis_t amplnoise = _dist(_prng)*_amplnoise;
-
-        meshaxis_t phasemod = _modampl*std::sin(_modtimedelta*(i));
-
-        rv.emplace(std::array<meshaxis_t,2>{{ _syncphase+phasenoise+phasemod
-                                            , 1+amplnoise}});
-    }
-    return rv;
+    // Box-Muller transform, u1 is in (0,1] so that log(u1) is finite
+    const double u1 = ((z >> 32) + 1.0)/4294967296.0;
+    const double u2 = (z & UINT64_C(0xFFFFFFFF))/4294967296.0;
+    return std::sqrt(-2*std::log(u1))*std::cos(two_pi<double>()*u2);
 }
 
 void vfps::DynamicRFKickMap::_calcKick()
 {
-    RFKickMap::_calcKick( _next_modulation.front()[0]
-                        , _next_modulation.front()[1]);
+    const meshaxis_t phasenoise = _normal(_step,0)*_phasenoise;
+    const meshaxis_t amplnoise = _normal(_step,1)*_amplnoise;
+    const meshaxis_t phasemod = _modampl*std::sin(_modtimedelta*_step);
+
+    _past_modulation.emplace_back(
+                std::array<meshaxis_t,2>{{ _syncphase+phasenoise+phasemod
+                                         , 1+amplnoise}});
+    RFKickMap::_calcKick( _past_modulation.back()[0]
+                        , _past_modulation.back()[1]);
 }
 
 void vfps::DynamicRFKickMap::apply() {
     _calcKick();
     KickMap::apply();
+    _step++;
+}
 
-    // move front entry from next to past
-    _past_modulation.emplace_back(std::move(_next_modulation.front()));
-    _next_modulation.pop();
+void vfps::DynamicRFKickMap::applyFused(KickMap& first) {
+    _calcKick();
+    KickMap::applyFused(first);
+    _step++;
 }
 
 std::vector<std::array<vfps::meshaxis_t,2>>
@@ -137,6 +137,49 @@ vfps::FokkerPlanckMap::FokkerPlanckMap( std::shared_ptr<PhaseSpace> in
         }
         dst[meshoffs+y] = value;
     }
+
+    // same as applySM_Y (for one bunch) followed by projectionX,
+    // one work-group per column (x), the column is kept in local memory
+    __kernel void applySM_Y_projX(const __global data_t* src,
+                                  const __global hi* sm,
+                                  const uint sm_len,
+                                  const uint ysize,
+                                  __global data_t* dst,
+                                  const __global data_t* ws,
+                                  __global data_t* proj,
+                                  __local data_t* col)
+    {
+        const uint x = get_group_id(0);
+        const uint l = get_local_id(0);
+        const uint nl = get_local_size(0);
+        const uint meshoffs = x*ysize;
+        for (uint y=l; y<ysize; y+=nl) {
+            col[y] = src[meshoffs+y];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        data_t partial = 0;
+        for (uint y=l; y<ysize; y+=nl) {
+            const uint smoffset = y*sm_len;
+            data_t value = 0;
+            for (uint j=0; j<sm_len; j++) {
+                value += mult(col[sm[smoffset+j].src],sm[smoffset+j].weight);
+            }
+            dst[meshoffs+y] = value;
+            partial += value*ws[y];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        col[l] = partial;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (uint s=nl/2; s>0; s/=2) {
+            if (l < s) {
+                col[l] += col[l+s];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (l == 0) {
+            proj[x] = col[0];
+        }
+    }
     )";
 
     _cl_prog = _oclh->prepareCLProg(_cl_code);
@@ -152,6 +195,26 @@ vfps::FokkerPlanckMap::FokkerPlanckMap( std::shared_ptr<PhaseSpace> in
         applySM.setArg(2, _ip);
         applySM.setArg(3, _ysize);
         applySM.setArg(4, _out->data_buf);
+        _clAccess.read.push_back(_sm_buf);
+
+        const size_t colsize = sizeof(meshdata_t)*_ysize;
+        if (PhaseSpace::nb == 1 && colsize <= _oclh->localMemSize()) {
+            _clKernProjected = cl::Kernel(_cl_prog, "applySM_Y_projX");
+            const size_t maxsize = std::min( _oclh->maxWorkGroupSize(_clKernProjected)
+                                           , static_cast<size_t>(_ysize));
+            size_t lsize = 1;
+            while (2*lsize <= std::min(maxsize,static_cast<size_t>(256))) {
+                lsize *= 2;
+            }
+            _clProjectedLocal = cl::NDRange(lsize);
+            _clKernProjected.setArg(1, _sm_buf);
+            _clKernProjected.setArg(2, _ip);
+            _clKernProjected.setArg(3, _ysize);
+            _clKernProjected.setArg(5, _out->ws_buf);
+            _clKernProjected.setArg(7, cl::Local(colsize));
+            _clProjectedAccess = { {_in->data_buf,_sm_buf,_out->ws_buf}
+                                 , {_out->data_buf,_out->projectionX_clbuf}};
+        }
     }
     }
 #endif
@@ -173,17 +236,18 @@ void vfps::FokkerPlanckMap::apply()
         #if INOVESA_SYNC_CL == 1
         _in->syncCLMem(OCLH::clCopyDirection::cpu2dev);
         #endif // INOVESA_SYNC_CL
-        _oclh->enqueueNDRangeKernel( applySM
+        const cl::NDRange global(_meshxsize,_ysize);
+        _oclh->enqueueNDRangeKernel( _clAccess
+                                  , applySM
                                   , cl::NullRange
-                                  , cl::NDRange(_meshxsize,_ysize)
+                                  , global
+                                  , _oclh->localSize(_clAccess,applySM,global)
                                   #if INOVESA_ENABLE_CLPROFILING == 1
-                                  , cl::NullRange
                                   , nullptr
                                   , nullptr
                                   , applySMEvents.get()
                                   #endif // INOVESA_ENABLE_CLPROFILING
                                   );
-        _oclh->enqueueBarrier();
         #if INOVESA_SYNC_CL == 1
         _out->syncCLMem(OCLH::clCopyDirection::dev2cpu);
         #endif // INOVESA_SYNC_CL
@@ -211,6 +275,36 @@ void vfps::FokkerPlanckMap::apply()
     }
 }
 
+void vfps::FokkerPlanckMap::applyAndUpdateXProjection()
+{
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh && _clKernProjected() != nullptr) {
+        #if INOVESA_SYNC_CL == 1
+        _in->syncCLMem(OCLH::clCopyDirection::cpu2dev);
+        #endif // INOVESA_SYNC_CL
+        const size_t colbytes = sizeof(meshdata_t)*_ysize;
+        _oclh->enqueueColumnBlocks( _clProjectedAccess
+                                  , _clKernProjected
+                                  , {{0, _in->data_buf, colbytes}
+                                    ,{4, _out->data_buf, colbytes}
+                                    ,{6, _out->projectionX_clbuf
+                                     , sizeof(projection_t)}}
+                                  , _meshxsize
+                                  , _clProjectedLocal.get()[0]
+                                  #if INOVESA_ENABLE_CLPROFILING == 1
+                                  , applySMEvents.get()
+                                  #endif // INOVESA_ENABLE_CLPROFILING
+                                  );
+        #if INOVESA_SYNC_CL == 1
+        _out->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+        #endif // INOVESA_SYNC_CL
+        return;
+    }
+    #endif // INOVESA_USE_OPENCL
+    apply();
+    _out->updateXProjection();
+}
+
 vfps::PhaseSpace::Position
 vfps::FokkerPlanckMap::apply(PhaseSpace::Position pos) const
 {
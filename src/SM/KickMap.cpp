@@ -43,8 +43,9 @@ vfps::KickMap::KickMap(std::shared_ptr<PhaseSpace> in
     #endif
     #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
+        // holds all bunches (like _offset), kicks use the first one
         _offset_clbuf = cl::Buffer(_oclh->context,CL_MEM_READ_WRITE,
-                                sizeof(meshaxis_t)*_meshsize_pd);
+                                sizeof(meshaxis_t)*_offset.size());
         _cl_code += R"(
         __kernel void apply_xKick(const __global data_t* src,
                                   const __global data_t* dx,
@@ -95,6 +96,65 @@ vfps::KickMap::KickMap(std::shared_ptr<PhaseSpace> in
         }
         )";
 
+        // Tiled variant of apply_xKick: Every work-item computes one mesh
+        // point. Rows (x+dxi-1) to (x+dxi+2) needed by a tile are first
+        // loaded to local memory, so each element is read only once from
+        // global memory instead of four times.
+        _cl_code += "#define TILE "+std::to_string(_tilesize)+"\n";
+        _cl_code += R"(
+        __kernel void apply_xKick_tiled(const __global data_t* src,
+                                        const __global data_t* dx,
+                                        const int meshsize,
+                                        __global data_t* dst)
+        {
+            __local data_t tile[TILE+3][TILE];
+            const int y = get_global_id(0);
+            const int x = get_global_id(1);
+            const int ly = get_local_id(0);
+            const int lx = get_local_id(1);
+            const int x0 = get_group_id(1)*TILE;
+            const bool active = (y < meshsize && x < meshsize);
+            int dxi = 0;
+            data_t dxf = 0;
+            if (y < meshsize) {
+                dxi = clamp((int)(floor(dx[y])),-meshsize,meshsize);
+                dxf = dx[y] - dxi;
+            }
+            for (int i=lx; i<TILE+3; i+=TILE) {
+                const int xs = x0+dxi-1+i;
+                tile[i][ly] = (y < meshsize && xs >= 0 && xs < meshsize)
+                            ? src[xs*meshsize+y] : 0;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (!active) {
+                return;
+            }
+            if (x-1+dxi < 0 || x+2+dxi >= meshsize) {
+                dst[x*meshsize+y] = 0;
+                return;
+            }
+        )";
+        if (interpol_clamp) {
+            _cl_code += R"(
+            data_t ceil = max(tile[lx+1][ly],tile[lx+2][ly]);
+            data_t flor = min(tile[lx+1][ly],tile[lx+2][ly]);
+            )";
+        }
+        _cl_code += R"(
+            data_t value = mult(tile[lx  ][ly],(dxf  )*(dxf-1)*(dxf-2)/(-6))
+                         + mult(tile[lx+1][ly],(dxf+1)*(dxf-1)*(dxf-2)/( 2))
+                         + mult(tile[lx+2][ly],(dxf+1)*(dxf  )*(dxf-2)/(-2))
+                         + mult(tile[lx+3][ly],(dxf+1)*(dxf  )*(dxf-1)/( 6));
+        )";
+        if (interpol_clamp) {
+            _cl_code += "dst[x*meshsize+y] = clamp(value,flor,ceil);";
+        } else {
+            _cl_code += "dst[x*meshsize+y] = value;";
+        }
+        _cl_code += R"(
+        }
+        )";
+
         _cl_code += R"(
         __kernel void apply_yKick(const __global data_t* src,
                                   const __global data_t* dy,
@@ -147,10 +207,72 @@ vfps::KickMap::KickMap(std::shared_ptr<PhaseSpace> in
             }
         }
         )";
+
+        // Two consecutive y-kicks, one work-group per column (x).
+        // The column is kept in local memory, so it is read and written
+        // only once from global memory. As every work-group reads its
+        // full column before writing, src and dst may be the same.
+        _cl_code += R"(
+        data_t yKickValue(const __local data_t* src, const int y,
+                          const int dyi, const data_t dyf,
+                          const int meshsize);
+        data_t yKickValue(const __local data_t* src, const int y,
+                          const int dyi, const data_t dyf,
+                          const int meshsize)
+        {
+            if (y-1+dyi < 0 || y+2+dyi >= meshsize) {
+                return 0;
+            }
+            return mult(src[y-1+dyi],(dyf  )*(dyf-1)*(dyf-2)/(-6))
+                 + mult(src[y  +dyi],(dyf+1)*(dyf-1)*(dyf-2)/( 2))
+                 + mult(src[y+1+dyi],(dyf+1)*(dyf  )*(dyf-2)/(-2))
+                 + mult(src[y+2+dyi],(dyf+1)*(dyf  )*(dyf-1)/( 6));
+        }
+
+        __kernel void apply_yKick2(const __global data_t* src,
+                                   const __global data_t* dy1,
+                                   const __global data_t* dy2,
+                                   const int meshsize,
+                                   __global data_t* dst,
+                                   __local data_t* col0,
+                                   __local data_t* col1)
+        {
+            const int x = get_group_id(0);
+            const int l = get_local_id(0);
+            const int nl = get_local_size(0);
+            const int meshoffs = x*meshsize;
+            const int dyi1 = clamp((int)(floor(dy1[x])),-meshsize,meshsize);
+            const data_t dyf1 = dy1[x] - dyi1;
+            const int dyi2 = clamp((int)(floor(dy2[x])),-meshsize,meshsize);
+            const data_t dyf2 = dy2[x] - dyi2;
+            for (int y=l; y<meshsize; y+=nl) {
+                col0[y] = src[meshoffs+y];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+            for (int y=l; y<meshsize; y+=nl) {
+                col1[y] = yKickValue(col0,y,dyi1,dyf1,meshsize);
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+            for (int y=l; y<meshsize; y+=nl) {
+                dst[meshoffs+y] = yKickValue(col1,y,dyi2,dyf2,meshsize);
+            }
+        }
+        )";
         _cl_prog  = _oclh->prepareCLProg(_cl_code);
 
+        _clGlobal = cl::NDRange(_meshsize_pd);
+        _clLocal = cl::NullRange;
         if (_kickdirection == Axis::x) {
-            applySM = cl::Kernel(_cl_prog, "apply_xKick");
+            applySM = cl::Kernel(_cl_prog, "apply_xKick_tiled");
+            if (_oclh->maxWorkGroupSize(applySM) >= _tilesize*_tilesize) {
+                // round up, surplus work-items only help loading the tiles
+                const cl_int ntiles_pd = (_meshsize_pd+_tilesize-1)/_tilesize;
+                const cl_int ntiles_kd = (_meshsize_kd+_tilesize-1)/_tilesize;
+                _clGlobal = cl::NDRange(ntiles_pd*_tilesize,ntiles_kd*_tilesize);
+                _clLocal = cl::NDRange(_tilesize,_tilesize);
+            } else {
+                applySM = cl::Kernel(_cl_prog, "apply_xKick");
+            }
         } else {
             applySM = cl::Kernel(_cl_prog, "apply_yKick");
         }
@@ -158,6 +280,24 @@ vfps::KickMap::KickMap(std::shared_ptr<PhaseSpace> in
         applySM.setArg(1, _offset_clbuf);
         applySM.setArg(2, _meshsize_kd);
         applySM.setArg(3, _out->data_buf);
+        _clAccess.read.push_back(_offset_clbuf);
+
+        const size_t colsize = sizeof(meshdata_t)*_meshsize_kd;
+        // the fused kernel works on one bunch only
+        if ( PhaseSpace::nb == 1 && _kickdirection == Axis::y
+          && 2*colsize <= _oclh->localMemSize()) {
+            _clKernFused = cl::Kernel(_cl_prog, "apply_yKick2");
+            const size_t maxsize = std::min( _oclh->maxWorkGroupSize(_clKernFused)
+                                           , static_cast<size_t>(_meshsize_kd));
+            size_t lsize = 1;
+            while (2*lsize <= std::min(maxsize,static_cast<size_t>(256))) {
+                lsize *= 2;
+            }
+            _clFusedLocal = cl::NDRange(lsize);
+            _clKernFused.setArg(3, _meshsize_kd);
+            _clKernFused.setArg(5, cl::Local(colsize));
+            _clKernFused.setArg(6, cl::Local(colsize));
+        }
     }
 #endif // INOVESA_USE_OPENCL
 }
@@ -178,17 +318,19 @@ void vfps::KickMap::apply()
         #if INOVESA_SYNC_CL == 1
         _in->syncCLMem(OCLH::clCopyDirection::cpu2dev);
         #endif // INOVESA_SYNC_CL
-        _oclh->enqueueNDRangeKernel( applySM
+        _oclh->enqueueNDRangeKernel( _clAccess
+                                  , applySM
                                   , cl::NullRange
-                                  , cl::NDRange(_meshsize_pd)
+                                  , _clGlobal
+                                  , _clLocal.dimensions() > 0
+                                    ? _clLocal
+                                    : _oclh->localSize(_clAccess,applySM,_clGlobal)
                                   #if INOVESA_ENABLE_CLPROFILING == 1
-                                  , cl::NullRange
                                   , nullptr
                                   , nullptr
                                   , applySMEvents.get()
                                   #endif // INOVESA_ENABLE_CLPROFILING
                                   );
-        _oclh->enqueueBarrier();
         #if INOVESA_SYNC_CL == 1
         _out->syncCLMem(OCLH::clCopyDirection::dev2cpu);
         #endif // INOVESA_SYNC_CL
@@ -247,6 +389,45 @@ void vfps::KickMap::apply()
     }
 }
 
+void vfps::KickMap::applyFused(KickMap& first)
+{
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh && _clKernFused() != nullptr && first._oclh
+            && first._kickdirection == Axis::y
+            && first._meshsize_kd == _meshsize_kd
+            && first._meshsize_pd == _meshsize_pd
+            && first._out == _in) {
+        #if INOVESA_SYNC_CL == 1
+        first._in->syncCLMem(OCLH::clCopyDirection::cpu2dev);
+        #endif // INOVESA_SYNC_CL
+        const OCLH::Access access{{ first._in->data_buf
+                                  , first._offset_clbuf
+                                  , _offset_clbuf}
+                                  , {_out->data_buf}};
+        // every work-group processes one column, so they can be distributed
+        const size_t colbytes = sizeof(meshdata_t)*_meshsize_kd;
+        _oclh->enqueueColumnBlocks( access
+                                  , _clKernFused
+                                  , {{0, first._in->data_buf, colbytes}
+                                    ,{1, first._offset_clbuf, sizeof(meshaxis_t)}
+                                    ,{2, _offset_clbuf, sizeof(meshaxis_t)}
+                                    ,{4, _out->data_buf, colbytes}}
+                                  , _meshsize_pd
+                                  , _clFusedLocal.get()[0]
+                                  #if INOVESA_ENABLE_CLPROFILING == 1
+                                  , applySMEvents.get()
+                                  #endif // INOVESA_ENABLE_CLPROFILING
+                                  );
+        #if INOVESA_SYNC_CL == 1
+        _out->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+        #endif // INOVESA_SYNC_CL
+        return;
+    }
+    #endif // INOVESA_USE_OPENCL
+    first.apply();
+    KickMap::apply();
+}
+
 vfps::PhaseSpace::Position
 vfps::KickMap::apply(PhaseSpace::Position pos) const
 {
@@ -301,6 +482,13 @@ void vfps::KickMap::syncCLMem(OCLH::clCopyDirection dir)
         break;
     }
 }
+
+void vfps::KickMap::download()
+{
+    _oclh->enqueueDownload( _offset_clbuf
+                          , sizeof(meshaxis_t)*_meshsize_pd
+                          , _offset.data());
+}
 #endif // INOVESA_USE_OPENCL
 
 void vfps::KickMap::updateSM()
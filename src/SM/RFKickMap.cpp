@@ -30,6 +30,9 @@ vfps::RFKickMap::RFKickMap( std::shared_ptr<PhaseSpace> in
   , _syncphase(0)
   , _bl2phase(_axis[0]->scale("Meter")/physcons::c*_f_RF*two_pi<double>())
 {
+    #if INOVESA_USE_OPENCL == 1
+    _prepareCLKick();
+    #endif // INOVESA_USE_OPENCL
     _calcKick(_syncphase);
 }
 
@@ -55,35 +58,138 @@ vfps::RFKickMap::RFKickMap(std::shared_ptr<PhaseSpace> in
   , _syncphase(std::asin(_V0/_V_RF))
   , _bl2phase(_axis[0]->scale("Meter")/physcons::c*_f_RF*two_pi<double>())
 {
+    #if INOVESA_USE_OPENCL == 1
+    _prepareCLKick();
+    #endif // INOVESA_USE_OPENCL
     _calcKick(_syncphase);
 }
 
-void vfps::RFKickMap::_calcKick(const meshaxis_t phase, const meshaxis_t ampl)
+#if INOVESA_USE_OPENCL == 1
+void vfps::RFKickMap::_prepareCLKick()
 {
-    if (_linear) {
-        meshaxis_t phaseoffs = (_syncphase-phase);
-        const meshaxis_t xcenter = _in->getAxis(0)->zerobin();
-        for(meshindex_t x=0; x<_xsize; x++) {
-            _offset[x] = std::tan(_angle)*(xcenter-x);
-            _offset[x] += std::tan(_angle)*phaseoffs/_bl2phase/_axis[0]->delta();
-            _offset[x] *= ampl;
+    if (!_oclh) {
+        return;
+    }
+    _clProgKick = _oclh->prepareCLProg(R"(
+        __kernel void linearRFKick(__global data_t* offset,
+                                   const data_t phase,
+                                   const data_t ampl,
+                                   const data_t slope,
+                                   const data_t xcenter,
+                                   const data_t syncphase,
+                                   const data_t phasescale)
+        {
+            const int x = get_global_id(0);
+            offset[x] = ampl*slope*( (xcenter-x)
+                                   + (syncphase-phase)*phasescale);
+        }
+
+        __kernel void sinRFKick(__global data_t* offset,
+                                const data_t phase,
+                                const data_t ampl,
+                                const __global data_t* rfphase,
+                                const data_t V_RF,
+                                const data_t V0,
+                                const data_t scale)
+        {
+            const int x = get_global_id(0);
+            offset[x] = scale*(V0-ampl*V_RF*sin(rfphase[x]+phase));
         }
+        )");
+    _clKickAccess.write.push_back(_offset_clbuf);
+    if (_linear) {
+        _clKernKick = cl::Kernel(_clProgKick,"linearRFKick");
+        _clKernKick.setArg(3,static_cast<meshaxis_t>(std::tan(_angle)));
+        _clKernKick.setArg(4,static_cast<meshaxis_t>(_in->getAxis(0)->zerobin()));
+        _clKernKick.setArg(5,_syncphase);
+        _clKernKick.setArg(6,static_cast<meshaxis_t>(1/_bl2phase/_axis[0]->delta()));
     } else {
+        std::vector<meshaxis_t> rfphase(_xsize);
         for(meshindex_t x=0; x<_xsize; x++) {
-            _offset[x] = _revolutionpart*(-ampl*_V_RF
-                       * std::sin(_axis[0]->at(x)*_bl2phase+phase)
-                       + _V0)/ _axis[1]->delta()/_axis[1]->scale("ElectronVolt");
+            rfphase[x] = _axis[0]->at(x)*_bl2phase;
         }
+        _rfphase_clbuf = cl::Buffer( _oclh->context
+                                   , CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR
+                                   , sizeof(meshaxis_t)*_xsize
+                                   , rfphase.data());
+        _clKickAccess.read.push_back(_rfphase_clbuf);
+        _clKernKick = cl::Kernel(_clProgKick,"sinRFKick");
+        _clKernKick.setArg(3,_rfphase_clbuf);
+        _clKernKick.setArg(4,_V_RF);
+        _clKernKick.setArg(5,_V0);
+        _clKernKick.setArg(6,static_cast<meshaxis_t>( _revolutionpart
+                                                    / _axis[1]->delta()
+                                                    / _axis[1]->scale("ElectronVolt")));
     }
+    _clKernKick.setArg(0,_offset_clbuf);
+}
+#endif // INOVESA_USE_OPENCL
 
+void vfps::RFKickMap::_calcKick(const meshaxis_t phase, const meshaxis_t ampl)
+{
+    _phase = phase;
+    _ampl = ampl;
     #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
-        syncCLMem(OCLH::clCopyDirection::cpu2dev);
+        _clKernKick.setArg(1,phase);
+        _clKernKick.setArg(2,ampl);
+        const cl::NDRange global(_xsize);
+        _oclh->enqueueNDRangeKernel( _clKickAccess
+                                   , _clKernKick
+                                   , cl::NullRange
+                                   , global
+                                   , _oclh->localSize( _clKickAccess
+                                                     , _clKernKick
+                                                     , global));
+        return;
     }
     #endif // INOVESA_USE_OPENCL
+    for(meshindex_t x=0; x<_xsize; x++) {
+        _offset[x] = _kick(x,phase,ampl);
+    }
     updateSM();
 }
 
+vfps::meshaxis_t vfps::RFKickMap::_kick( const meshindex_t x
+                                       , const meshaxis_t phase
+                                       , const meshaxis_t ampl) const
+{
+    meshaxis_t offset;
+    if (_linear) {
+        meshaxis_t phaseoffs = (_syncphase-phase);
+        const meshaxis_t xcenter = _in->getAxis(0)->zerobin();
+        offset = std::tan(_angle)*(xcenter-x);
+        offset += std::tan(_angle)*phaseoffs/_bl2phase/_axis[0]->delta();
+        offset *= ampl;
+    } else {
+        offset = _revolutionpart*(-ampl*_V_RF
+               * std::sin(_axis[0]->at(x)*_bl2phase+phase)
+               + _V0)/ _axis[1]->delta()/_axis[1]->scale("ElectronVolt");
+    }
+    return offset;
+}
+
+vfps::PhaseSpace::Position
+vfps::RFKickMap::apply(PhaseSpace::Position pos) const
+{
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh) {
+        meshindex_t xi;
+        interpol_t xif;
+        interpol_t xf = std::modf(pos.x, &xif);
+        xi = xif;
+        if (xi+1 < static_cast<meshindex_t>(_meshsize_pd)) {
+            pos.y -= (1-xf)*_kick(xi,_phase,_ampl)
+                   + xf*_kick(xi+1,_phase,_ampl);
+        }
+        pos.y = std::max(static_cast<meshaxis_t>(1),
+                     std::min(pos.y,static_cast<meshaxis_t>(_meshsize_kd-1)));
+        return pos;
+    }
+    #endif // INOVESA_USE_OPENCL
+    return KickMap::apply(pos);
+}
+
 vfps::RFKickMap::~RFKickMap() noexcept
 #if INOVESA_ENABLE_CLPROFILING == 1
 {
@@ -34,6 +34,10 @@ vfps::SourceMap::SourceMap( std::shared_ptr<PhaseSpace> in
 {
     #if INOVESA_USE_OPENCL == 1
     _cl_code  += "typedef struct { uint src; data_t weight; } hi;\n";
+    if (_oclh) {
+        // derived maps add the buffers holding their map
+        _clAccess = {{_in->data_buf},{_out->data_buf}};
+    }
     #endif // INOVESA_USE_OPENCL
 }
 
@@ -80,11 +84,13 @@ void vfps::SourceMap::apply()
         #if INOVESA_SYNC_CL == 1
         _in->syncCLMem(OCLH::clCopyDirection::cpu2dev);
         #endif // INOVESA_SYNC_CL
-        _oclh->enqueueNDRangeKernel( applySM
+        const cl::NDRange global(PhaseSpace::nxy);
+        _oclh->enqueueNDRangeKernel( _clAccess
+                                  , applySM
                                   , cl::NullRange
-                                  , cl::NDRange(PhaseSpace::nxy)
+                                  , global
+                                  , _oclh->localSize(_clAccess,applySM,global)
                                   #if INOVESA_ENABLE_CLPROFILING == 1
-                                  , cl::NullRange
                                   , nullptr
                                   , nullptr
                                   , applySMEvents.get()
@@ -7,6 +7,10 @@
 
 #include "SM/WakeFunctionMap.hpp"
 
+#include <chrono>
+
+#include "IO/FSPath.hpp"
+
 vfps::WakeFunctionMap::WakeFunctionMap( std::shared_ptr<PhaseSpace> in
                                       , std::shared_ptr<PhaseSpace> out
                                       , const meshindex_t xsize
@@ -26,6 +30,13 @@ vfps::WakeFunctionMap::WakeFunctionMap( std::shared_ptr<PhaseSpace> in
                             , in->getScale(0)))
   , _wakefunction(new meshaxis_t[2*xsize])
   , _wakesize(2*xsize)
+  , _method(ConvolutionMethod::direct)
+  , _density_padded(nullptr)
+  , _density_fft(nullptr)
+  , _wakespectrum(nullptr)
+  , _convolution(nullptr)
+  , _fft_density(nullptr)
+  , _fft_convolution(nullptr)
 {
 }
 
@@ -48,6 +59,7 @@ vfps::WakeFunctionMap::WakeFunctionMap( std::shared_ptr<PhaseSpace> in
      *  1/(ps->getDelta(1)*sigmaE*E0): eV -> pixels
      */
     _wakeFromFile(fname,1e12*Ib*dt/(in->getDelta(1)*E0*sigmaE));
+    _prepareConvolution();
 }
 
 vfps::WakeFunctionMap::WakeFunctionMap( std::shared_ptr<PhaseSpace> in
@@ -62,11 +74,22 @@ vfps::WakeFunctionMap::WakeFunctionMap( std::shared_ptr<PhaseSpace> in
   : WakeFunctionMap( in,out,xsize,ysize,it,interpol_clamp, oclh)
 {
     std::copy_n(csr->getWakefunction(),2*xsize,_wakefunction);
+    _prepareConvolution();
 }
 
 vfps::WakeFunctionMap::~WakeFunctionMap() noexcept
 {
     delete [] _wakefunction;
+    if (_fft_density != nullptr) {
+        fftwf_destroy_plan(_fft_density);
+    }
+    if (_fft_convolution != nullptr) {
+        fftwf_destroy_plan(_fft_convolution);
+    }
+    fftwf_free(_density_padded);
+    fftwf_free(_density_fft);
+    fftwf_free(_wakespectrum);
+    fftwf_free(_convolution);
     #if INOVESA_ENABLE_CLPROFILING == 1
     saveTimings("WakeFunctionMap");
     #endif // INOVESA_ENABLE_CLPROFILING
@@ -74,23 +97,209 @@ vfps::WakeFunctionMap::~WakeFunctionMap() noexcept
 
 void vfps::WakeFunctionMap::update()
 {
-    #if INOVESA_USE_OPENCL
+    #if INOVESA_USE_OPENCL == 1
     if (_oclh) {
-        _in->syncCLMem(OCLH::clCopyDirection::dev2cpu);
-    }
+        // bunch population and wake are computed from the projection,
+        // so there is no need to transfer the phase space
+        _in->integrate();
+        const OCLH::Access access{{ _in->projectionX_clbuf
+                                  , _wakefunction_clbuf
+                                  , _in->bunchpop_buf}
+                                  , {_offset_clbuf}};
+        const cl::NDRange global(_xsize,PhaseSpace::nb);
+        _oclh->enqueueNDRangeKernel( access
+                                   , _clKernWakeConv
+                                   , cl::NullRange
+                                   , global
+                                   , _oclh->localSize(access,_clKernWakeConv,global)
+                                   #if INOVESA_ENABLE_CLPROFILING == 1
+                                   , nullptr
+                                   , nullptr
+                                   , applySMEvents.get()
+                                   #endif // INOVESA_ENABLE_CLPROFILING
+                                   );
+        #if INOVESA_SYNC_CL == 1
+        syncCLMem(OCLH::clCopyDirection::dev2cpu);
+        #endif // INOVESA_SYNC_CL
+    } else
     #endif // INOVESA_USE_OPENCL
-    _in->integrate();
-    integral_t charge = _in->getIntegral();
-    const integral_t* density = _in->getProjection(0);
-    for (unsigned int i=0;i<_xsize;i++) {
-        _offset[i] = 0;
-        for (unsigned int j=0;j<_xsize;j++) {
-            _offset[i] += meshaxis_t(density[j]/charge*_wakefunction[_xsize+i-j]);
+    {
+        _in->integrate();
+        const meshaxis_t scale = 1/_in->getIntegral();
+        const projection_t* density = _in->getProjection(0);
+        for (meshindex_t n=0; n<PhaseSpace::nb; n++) {
+            if (_method == ConvolutionMethod::fft) {
+                _convolveFFT(density+n*_xsize,scale,_offset.data()+n*_xsize);
+            } else {
+                _convolveDirect(density+n*_xsize,scale,_offset.data()+n*_xsize);
+            }
         }
     }
     updateSM();
 }
 
+void vfps::WakeFunctionMap::_convolveDirect(const projection_t* density
+                                           , const meshaxis_t scale
+                                           , meshaxis_t* result)
+{
+    std::fill_n(result,_xsize,meshaxis_t(0));
+    for (meshindex_t j=0; j<_xsize; j++) {
+        const meshaxis_t dj = density[j]*scale;
+        const meshaxis_t* wake = _wakefunction+_xsize-j;
+        for (meshindex_t i=0; i<_xsize; i++) {
+            result[i] += dj*wake[i];
+        }
+    }
+}
+
+void vfps::WakeFunctionMap::_convolveFFT(const projection_t* density
+                                        , const meshaxis_t scale
+                                        , meshaxis_t* result)
+{
+    for (meshindex_t j=0; j<_xsize; j++) {
+        _density_padded[j] = density[j]*scale;
+    }
+    // the upper half stays zero from allocation
+    fftwf_execute(_fft_density);
+    for (size_t k=0; k<_wakesize/2+1; k++) {
+        const float re = _density_fft[k][0]*_wakespectrum[k][0]
+                       - _density_fft[k][1]*_wakespectrum[k][1];
+        const float im = _density_fft[k][0]*_wakespectrum[k][1]
+                       + _density_fft[k][1]*_wakespectrum[k][0];
+        _density_fft[k][0] = re;
+        _density_fft[k][1] = im;
+    }
+    fftwf_execute(_fft_convolution);
+    std::copy_n(_convolution+_xsize,_xsize,result);
+}
+
+void vfps::WakeFunctionMap::_prepareConvolution()
+{
+    #if INOVESA_USE_OPENCL == 1
+    if (_oclh) {
+        _wakefunction_clbuf = cl::Buffer( _oclh->context
+                                        , CL_MEM_READ_ONLY|CL_MEM_COPY_HOST_PTR
+                                        , sizeof(meshaxis_t)*_wakesize
+                                        , _wakefunction);
+        _clProgWakeConv = _oclh->prepareCLProg(R"(
+            __kernel void wakeconvolution(const __global data_t* proj,
+                                          const __global data_t* wake,
+                                          const __global data_t* bunchpop,
+                                          const uint xsize,
+                                          const uint nbunches,
+                                          __global data_t* offset)
+            {
+                const uint i = get_global_id(0);
+                const uint n = get_global_id(1);
+                // normalized to the total charge (like on the host)
+                data_t charge = 0;
+                for (uint b=0; b<nbunches; b++) {
+                    charge += bunchpop[b];
+                }
+                const __global data_t* density = proj+n*xsize;
+                data_t value = 0;
+                for (uint j=0; j<xsize; j++) {
+                    value += density[j]*wake[xsize+i-j];
+                }
+                offset[n*xsize+i] = value/charge;
+            }
+            )");
+        _clKernWakeConv = cl::Kernel(_clProgWakeConv, "wakeconvolution");
+        _clKernWakeConv.setArg(0, _in->projectionX_clbuf);
+        _clKernWakeConv.setArg(1, _wakefunction_clbuf);
+        _clKernWakeConv.setArg(2, _in->bunchpop_buf);
+        _clKernWakeConv.setArg(3, _xsize);
+        _clKernWakeConv.setArg(4, PhaseSpace::nb);
+        _clKernWakeConv.setArg(5, _offset_clbuf);
+        _method = ConvolutionMethod::opencl;
+        return;
+    }
+    #endif // INOVESA_USE_OPENCL
+
+    _density_padded = fftwf_alloc_real(_wakesize);
+    _convolution = fftwf_alloc_real(_wakesize);
+    _density_fft = fftwf_alloc_complex(_wakesize/2+1);
+    _wakespectrum = fftwf_alloc_complex(_wakesize/2+1);
+    std::fill_n(_density_padded,_wakesize,0.0f);
+
+    std::stringstream wisdomfname;
+    wisdomfname << "wisdom_r2c32_" << _wakesize << ".fftw";
+    FSPath wisdompath(FSPath::datapath());
+    wisdompath.append("fftwisdom/"+wisdomfname.str());
+    if (fftwf_import_wisdom_from_filename(wisdompath.c_str()) != 0) {
+        _fft_density = fftwf_plan_dft_r2c_1d( _wakesize,_density_padded
+                                            , _density_fft
+                                            , FFTW_WISDOM_ONLY|FFTW_PATIENT);
+    }
+    if (_fft_density == nullptr) {
+        _fft_density = fftwf_plan_dft_r2c_1d( _wakesize,_density_padded
+                                            , _density_fft, FFTW_PATIENT);
+        fftwf_export_wisdom_to_filename(wisdompath.c_str());
+        Display::printText("Created some wisdom at "+wisdompath.str());
+    }
+
+    wisdomfname.str("");
+    wisdomfname << "wisdom_c2r32_" << _wakesize << ".fftw";
+    wisdompath = FSPath(FSPath::datapath());
+    wisdompath.append("fftwisdom/"+wisdomfname.str());
+    if (fftwf_import_wisdom_from_filename(wisdompath.c_str()) != 0) {
+        _fft_convolution = fftwf_plan_dft_c2r_1d( _wakesize,_density_fft
+                                                , _convolution
+                                                , FFTW_WISDOM_ONLY
+                                                 |FFTW_PATIENT);
+    }
+    if (_fft_convolution == nullptr) {
+        _fft_convolution = fftwf_plan_dft_c2r_1d( _wakesize,_density_fft
+                                                , _convolution, FFTW_PATIENT);
+        fftwf_export_wisdom_to_filename(wisdompath.c_str());
+        Display::printText("Created some wisdom at "+wisdompath.str());
+    }
+
+    // the spectrum of the wake is needed only once (normalized for iFFT)
+    std::copy_n(_wakefunction,_wakesize,_density_padded);
+    fftwf_execute(_fft_density);
+    for (size_t k=0; k<_wakesize/2+1; k++) {
+        _wakespectrum[k][0] = _density_fft[k][0]/_wakesize;
+        _wakespectrum[k][1] = _density_fft[k][1]/_wakesize;
+    }
+    std::fill_n(_density_padded,_wakesize,0.0f);
+
+    /* For small meshes, the direct convolution is faster.
+     * The crossover depends on the machine, so we just measure
+     * using the current bunch profile.
+     */
+    const projection_t* density = _in->getProjection(0);
+    constexpr uint_fast8_t repetitions = 4;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint_fast8_t r=0; r<repetitions; r++) {
+        _convolveDirect(density,1,_offset.data());
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (uint_fast8_t r=0; r<repetitions; r++) {
+        _convolveFFT(density,1,_offset.data());
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    std::fill_n(_density_padded,_wakesize,0.0f);
+    std::fill(_offset.begin(),_offset.end(),meshaxis_t(0));
+
+    std::stringstream sstream;
+    if (t2-t1 < t1-t0) {
+        _method = ConvolutionMethod::fft;
+        sstream << "Using FFT to apply wake function";
+    } else {
+        _method = ConvolutionMethod::direct;
+        sstream << "Using direct convolution to apply wake function";
+    }
+    sstream << " (direct: "
+            << std::chrono::duration<double,std::micro>(t1-t0).count()
+               /repetitions
+            << " us, FFT: "
+            << std::chrono::duration<double,std::micro>(t2-t1).count()
+               /repetitions
+            << " us).";
+    Display::printText(sstream.str());
+}
+
 void vfps::WakeFunctionMap::_wakeFromFile(const std::string fname,
                                           const double scaling)
 {
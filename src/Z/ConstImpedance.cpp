@@ -22,7 +22,8 @@ vfps::ConstImpedance::__calcImpedance(const size_t n,
 {
     std::vector<vfps::impedance_t> rv;
     rv.reserve(n);
-    rv.resize(n/2,Z);
+    // up to the Nyquist frequency (like the other models), also for odd n
+    rv.resize(n/2+1,Z);
     rv.resize(n,0);
 
     return rv;
@@ -7,7 +7,278 @@
 
 #include "Z/Impedance.hpp"
 
+#include "IO/Display.hpp"
+#include "IO/FSPath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <numeric>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace bip = boost::interprocess;
+namespace fs = boost::filesystem;
+
+namespace {
+
+/**
+ * @brief The CacheHeader struct starts the binary copy of impedance files
+ *
+ * It is followed by count harmonics (double) and count values (impedance_t).
+ * Size and modification time of the text file are used to detect changes.
+ */
+struct CacheHeader {
+    char magic[8];
+    uint64_t filesize;
+    int64_t mtime;
+    uint64_t count;
+};
+
+constexpr char cachemagic[8] = {'I','N','V','S','A','Z','0','1'};
+
+inline bool isSeparator(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+/**
+ * @brief parseNumber reads a decimal floating point number from [p,end)
+ * @return true if successful, p is then advanced behind the number
+ *
+ * This does not depend on the locale and does not need a terminating zero,
+ * so it can work directly on memory mapped files. Precision is plenty
+ * for impedance_t, but results might differ from strtod in the last bit.
+ */
+bool parseNumber(const char*& p, const char* const end, double& value)
+{
+    constexpr uint64_t maxmantissa = 100000000000000000ULL;
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+    uint64_t mantissa = 0;
+    int32_t exp10 = 0;
+    bool digits = false;
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        digits = true;
+        if (mantissa < maxmantissa) {
+            mantissa = 10*mantissa + static_cast<uint64_t>(*s - '0');
+        } else {
+            exp10++;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+            digits = true;
+            if (mantissa < maxmantissa) {
+                mantissa = 10*mantissa + static_cast<uint64_t>(*s - '0');
+                exp10--;
+            }
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s+1;
+        bool expnegative = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            expnegative = (*e == '-');
+            e++;
+        }
+        int32_t exponent = 0;
+        bool expdigits = false;
+        for (; e < end && *e >= '0' && *e <= '9'; e++) {
+            expdigits = true;
+            if (exponent < 10000) {
+                exponent = 10*exponent + (*e - '0');
+            }
+        }
+        if (expdigits) {
+            exp10 += expnegative ? -exponent : exponent;
+            s = e;
+        }
+    }
+    value = static_cast<double>(mantissa)*std::pow(10.0,exp10);
+    if (negative) {
+        value = -value;
+    }
+    p = s;
+    return true;
+}
+
+/**
+ * @brief The ImpedanceSamples class gives access to the data of a file
+ *
+ * If possible, the binary copy is memory mapped, so no data is copied.
+ */
+class ImpedanceSamples
+{
+public:
+    ImpedanceSamples(const std::string& fname);
+
+    size_t count;
+
+    const double* harmonic;
+
+    const vfps::impedance_t* value;
+
+private:
+    bool mapCache(const std::string& cname, const CacheHeader& expected);
+
+    void parseText(const std::string& fname);
+
+    void writeCache(const std::string& cname, CacheHeader header) const;
+
+    std::vector<double> _harmonic;
+
+    std::vector<vfps::impedance_t> _value;
+
+    bip::mapped_region _region;
+};
+
+ImpedanceSamples::ImpedanceSamples(const std::string& fname)
+  : count(0)
+  , harmonic(nullptr)
+  , value(nullptr)
+{
+    const std::string cname = fname+".inovesa-cache";
+    CacheHeader header;
+    std::memcpy(header.magic,cachemagic,sizeof(cachemagic));
+    header.filesize = fs::file_size(fname);
+    header.mtime = fs::last_write_time(fname);
+    header.count = 0;
+
+    if (mapCache(cname,header)) {
+        vfps::Display::printText("... using binary copy \""+cname+"\".");
+        return;
+    }
+
+    parseText(fname);
+    header.count = count;
+    writeCache(cname,header);
+    if (!mapCache(cname,header)) {
+        harmonic = _harmonic.data();
+        value = _value.data();
+    } else {
+        // data is now available from the cache
+        _harmonic = std::vector<double>();
+        _value = std::vector<vfps::impedance_t>();
+    }
+}
+
+/**
+ * @brief mapCache maps the binary copy
+ * @param expected header (count is not compared)
+ * @return false if file is not present or outdated
+ */
+bool ImpedanceSamples::mapCache( const std::string& cname
+                               , const CacheHeader& expected)
+{
+    try {
+        if (!fs::exists(cname)
+                || fs::file_size(cname) < sizeof(CacheHeader)) {
+            return false;
+        }
+        bip::file_mapping file(cname.c_str(),bip::read_only);
+        bip::mapped_region region(file,bip::read_only);
+        CacheHeader header;
+        std::memcpy(&header,region.get_address(),sizeof(CacheHeader));
+        const size_t datasize = header.count
+                * (sizeof(double)+sizeof(vfps::impedance_t));
+        if (std::memcmp(header.magic,expected.magic,sizeof(header.magic)) != 0
+                || header.filesize != expected.filesize
+                || header.mtime != expected.mtime
+                || region.get_size() != sizeof(CacheHeader)+datasize) {
+            return false;
+        }
+        _region.swap(region);
+        count = header.count;
+    } catch (const bip::interprocess_exception&) {
+        return false;
+    } catch (const fs::filesystem_error&) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(_region.get_address());
+    harmonic = reinterpret_cast<const double*>(data+sizeof(CacheHeader));
+    value = reinterpret_cast<const vfps::impedance_t*>(
+                data+sizeof(CacheHeader)+count*sizeof(double));
+    return true;
+}
+
+void ImpedanceSamples::parseText(const std::string& fname)
+{
+    if (fs::file_size(fname) > 0) {
+        bip::file_mapping file(fname.c_str(),bip::read_only);
+        bip::mapped_region region(file,bip::read_only);
+        const char* p = static_cast<const char*>(region.get_address());
+        const char* const end = p+region.get_size();
+
+        while (p < end) {
+            const char* eol = static_cast<const char*>(
+                        std::memchr(p,'\n',static_cast<size_t>(end-p)));
+            if (eol == nullptr) {
+                eol = end;
+            }
+            double n, re, im;
+            while (p < eol && isSeparator(*p)) p++;
+            if (parseNumber(p,eol,n)) {
+                while (p < eol && isSeparator(*p)) p++;
+                if (parseNumber(p,eol,re)) {
+                    while (p < eol && isSeparator(*p)) p++;
+                    if (parseNumber(p,eol,im)) {
+                        _harmonic.push_back(n);
+                        _value.emplace_back(re,im);
+                    }
+                }
+            }
+            p = eol+1;
+        }
+    }
+
+    if (!std::is_sorted(_harmonic.begin(),_harmonic.end())) {
+        std::vector<size_t> order(_harmonic.size());
+        std::iota(order.begin(),order.end(),0);
+        std::stable_sort(order.begin(),order.end(),
+                         [&](size_t a, size_t b)
+                         { return _harmonic[a] < _harmonic[b]; });
+        std::vector<double> h(order.size());
+        std::vector<vfps::impedance_t> z(order.size());
+        for (size_t i=0; i<order.size(); i++) {
+            h[i] = _harmonic[order[i]];
+            z[i] = _value[order[i]];
+        }
+        _harmonic.swap(h);
+        _value.swap(z);
+    }
+    count = _harmonic.size();
+}
+
+/**
+ * @brief writeCache stores parsed data next to the original file
+ *
+ * Failing to do so (e.g. in a read-only directory) is not an error.
+ */
+void ImpedanceSamples::writeCache( const std::string& cname
+                                 , CacheHeader header) const
+{
+    vfps::FSPath::writeAtomically(cname,[&](std::ostream& os) {
+        os.write(reinterpret_cast<const char*>(&header),sizeof(header));
+        os.write(reinterpret_cast<const char*>(_harmonic.data()),
+                 count*sizeof(double));
+        os.write(reinterpret_cast<const char*>(_value.data()),
+                 count*sizeof(vfps::impedance_t));
+    });
+}
+
+} // namespace
 
 vfps::Impedance::Impedance(const Impedance &other)
   : Impedance( Ruler<frequency_t>(other._axis),other._data, other._oclh)
@@ -48,10 +319,13 @@ vfps::Impedance::Impedance( const size_t nfreqs
 }
 
 vfps::Impedance::Impedance( std::string datafile
-                          , double f_max
+                          , const size_t nfreqs
+                          , const double f_rev
+                          , const double f_max
                           , oclhptr_t oclh
                           )
-  : Impedance( readData(datafile),f_max, oclh)
+  : Impedance( readData(datafile,nfreqs,f_max/f_rev/(nfreqs-1.0))
+             , f_max, oclh)
 {
 }
 
@@ -75,17 +349,42 @@ void vfps::Impedance::syncCLMem()
     #endif
 }
 
-std::vector<vfps::impedance_t> vfps::Impedance::readData(std::string fname)
+std::vector<vfps::impedance_t>
+vfps::Impedance::readData( std::string fname
+                         , const size_t nfreqs
+                         , const double delta)
 {
-    std::vector<vfps::impedance_t> rv;
-    std::ifstream is(fname);
-    size_t lineno;
-    double real;
-    double imag;
+    std::vector<vfps::impedance_t> rv(nfreqs,0);
+    const ImpedanceSamples samples(fname);
+    if (samples.count == 0) {
+        Display::printText("... no data found.");
+        return rv;
+    }
+    const double* h = samples.harmonic;
+    const impedance_t* z = samples.value;
+    const size_t last = samples.count-1;
+
+    std::stringstream msg;
+    msg << "... resampling " << samples.count << " values given for n="
+        << h[0] << " to " << h[last] << " (step " << delta << ").";
+    Display::printText(msg.str());
 
-    while(is.good()) {
-        is >> lineno >> real >> imag;
-        rv.push_back(impedance_t(real,imag));
+    // both, samples and frequencies, are sorted, so we can just walk along
+    size_t k = 0;
+    for (size_t i=0; i<=nfreqs/2 && i<nfreqs; i++) {
+        const double n = i*delta;
+        if (n < h[0] || n > h[last]) {
+            continue;
+        }
+        while (k < last && h[k+1] < n) {
+            k++;
+        }
+        if (k == last || h[k+1] == h[k]) {
+            rv[i] = z[k];
+        } else {
+            const auto t = static_cast<frequency_t>((n-h[k])/(h[k+1]-h[k]));
+            rv[i] = (1-t)*z[k] + t*z[k+1];
+        }
     }
     return rv;
 }
@@ -103,4 +402,23 @@ uint64_t vfps::Impedance::upper_power_of_two(uint64_t v)
     return v;
 }
 
+uint64_t vfps::Impedance::upper_smooth_number(uint64_t v)
+{
+    if (v <= 1) {
+        return 1;
+    }
+    // a power of two is always a candidate
+    uint64_t rv = upper_power_of_two(v);
+    for (uint64_t p5=1; p5 < rv; p5*=5) {
+        for (uint64_t p35=p5; p35 < rv; p35*=3) {
+            uint64_t candidate = p35;
+            while (candidate < v) {
+                candidate *= 2;
+            }
+            rv = std::min(rv,candidate);
+        }
+    }
+    return rv;
+}
+
 constexpr double vfps::Impedance::factor4Ohms;
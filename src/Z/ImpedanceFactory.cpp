@@ -8,6 +8,7 @@
 #include "Z/ImpedanceFactory.hpp"
 
 #include "IO/Display.hpp"
+#include "IO/FSPath.hpp"
 
 #include "Z/Impedance.hpp"
 #include "Z/ConstImpedance.hpp"
@@ -19,6 +20,99 @@
 #include <boost/math/constants/constants.hpp>
 using boost::math::constants::two_pi;
 
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+/**
+ * @brief cacheKey describes an impedance model unambiguously
+ * @param model name of the model (including a version of its implementation)
+ * @param nfreqs
+ * @param params all parameters that enter the computation
+ *
+ * Hexadecimal floats make sure that only bitwise identical
+ * parameters lead to the same key.
+ */
+std::string cacheKey( const std::string model
+                    , const size_t nfreqs
+                    , std::initializer_list<double> params)
+{
+    std::stringstream key;
+    key << model << ' ' << nfreqs << std::hexfloat;
+    for (auto p : params) {
+        key << ' ' << p;
+    }
+    return key.str();
+}
+
+/**
+ * @brief cachePath returns the file (in the data path) for a given key
+ *
+ * The file name contains a hash of the key (see FSPath::hexhash).
+ * As hashes might collide, the full key is also stored in the file
+ * and compared when loading.
+ */
+std::string cachePath(const std::string model, const std::string& key)
+{
+    return vfps::FSPath(vfps::FSPath::datapath())
+            .append("impedances/"+model+'_'+vfps::FSPath::hexhash(key)+".dat")
+            .str();
+}
+
+bool loadCachedImpedance( const std::string& path
+                        , const std::string& key
+                        , const size_t nfreqs
+                        , std::vector<vfps::impedance_t>& z)
+{
+    std::ifstream is(path, std::ios::binary);
+    std::string storedkey;
+    if (!std::getline(is,storedkey) || storedkey != key) {
+        return false;
+    }
+    z.resize(nfreqs);
+    is.read(reinterpret_cast<char*>(z.data()),
+            nfreqs*sizeof(vfps::impedance_t));
+    return is.gcount() == static_cast<std::streamsize>(
+                nfreqs*sizeof(vfps::impedance_t));
+}
+
+void saveCachedImpedance( const std::string& path
+                        , const std::string& key
+                        , const std::vector<vfps::impedance_t>& z)
+{
+    vfps::FSPath::writeAtomically(path,[&](std::ostream& os) {
+        os << key << '\n';
+        os.write(reinterpret_cast<const char*>(z.data()),
+                 z.size()*sizeof(vfps::impedance_t));
+    });
+}
+
+/**
+ * @brief cachedImpedance returns impedance data from the cache,
+ *        computes (and stores) it if it is not cached yet.
+ * @param compute function returning an Impedance matching the key
+ */
+template <typename Function>
+std::vector<vfps::impedance_t> cachedImpedance( const std::string model
+                                              , const size_t nfreqs
+                                              , std::initializer_list<double> params
+                                              , Function compute)
+{
+    const std::string key = cacheKey(model,nfreqs,params);
+    const std::string path = cachePath(model,key);
+    std::vector<vfps::impedance_t> z;
+    if (loadCachedImpedance(path,key,nfreqs,z)) {
+        vfps::Display::printText("... loaded from \""+path+"\".");
+    } else {
+        z = compute().impedance();
+        saveCachedImpedance(path,key,z);
+    }
+    return z;
+}
+
+} // namespace
+
 std::unique_ptr<vfps::Impedance>
 vfps::makeImpedance( const size_t nfreqs
                    , oclhptr_t oclh
@@ -49,7 +143,10 @@ vfps::makeImpedance( const size_t nfreqs
             Display::printText("... using CSR impedance");
             if (gap>0) {
                 Display::printText("... shielded by parallel plates.");
-                *rv += ParallelPlatesCSR(nfreqs,f0,fmax,gap);
+                *rv += Impedance(cachedImpedance(
+                    "ParallelPlatesCSR-v1",nfreqs,{f0,fmax,gap},
+                    [&](){ return ParallelPlatesCSR(nfreqs,f0,fmax,gap); }),
+                                 fmax);
             } else {
                 Display::printText("... in free space.");
                 *rv += FreeSpaceCSR(nfreqs,f0,fmax);
@@ -59,7 +156,11 @@ vfps::makeImpedance( const size_t nfreqs
         if ( s > 0 && xi >= -1 ) {
             impedance_changed = true;
             Display::printText("... using resistive wall impedance.");
-            *rv += ResistiveWall(nfreqs,frev,fmax,physcons::c/frev,s,xi,radius);
+            *rv += Impedance(cachedImpedance(
+                "ResistiveWall-v1",nfreqs,{frev,fmax,s,xi,radius},
+                [&](){ return ResistiveWall(nfreqs,frev,fmax,physcons::c/frev,
+                                            s,xi,radius); }),
+                             fmax);
         }
         if (0 < inner_coll_radius && inner_coll_radius < radius) {
             impedance_changed = true;
@@ -72,7 +173,7 @@ vfps::makeImpedance( const size_t nfreqs
         impedance_changed = true;
         Display::printText("Reading impedance from: \""
                            +impedance_file+"\"");
-        *rv += Impedance(impedance_file,fmax);
+        *rv += Impedance(impedance_file,nfreqs,frev,fmax);
     }
 
     // if impedance is still zero, a nullprt will be returned instead
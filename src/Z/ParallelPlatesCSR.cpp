@@ -36,7 +36,9 @@ vfps::ParallelPlatesCSR::__calcImpedance(const size_t nfreqs,
 
     const double r_bend = physcons::c/(2*pi<double>()*f0);
     constexpr std::complex<double> j(0,1);
-    for (size_t i=1; i<=nfreqs/2; i++) {
+
+    // work per frequency grows with n, forEachFrequency interleaves
+    forEachFrequency(1,nfreqs/2+1,[&](const size_t i) {
         std::complex<double> Z=0;
         const double n = i*delta;
         const double m = n*std::pow(g/r_bend,3./2.);
@@ -65,7 +67,7 @@ vfps::ParallelPlatesCSR::__calcImpedance(const size_t nfreqs,
          * impedance_t, to make this transparent.
          */
         rv[i] = static_cast<impedance_t>(Z);
-    }
+    });
 
     return rv;
 }
@@ -31,8 +31,7 @@ vfps::ResistiveWall::__calcImpedance(const size_t n,
                                      const double xi,
                                      const double b)
 {
-    std::vector<vfps::impedance_t> rv;
-    rv.reserve(n);
+    std::vector<vfps::impedance_t> rv(n,0);
 
     const double mu_r = (1+xi);
 
@@ -47,12 +46,9 @@ vfps::ResistiveWall::__calcImpedance(const size_t n,
     // frequency resolution: impedance will be sampled at multiples of delta
     const frequency_t delta = f_max/f0/(n-1.0);
 
-    for (size_t i=0; i<=n/2; i++) {
-        rv.push_back(Z1*std::sqrt(i*delta));
-    }
-    for (size_t i=n/2+1; i<n; i++) {
-        rv.push_back(impedance_t(0,0));
-    }
+    forEachFrequency(0,n/2+1,[&](const size_t i) {
+        rv[i] = Z1*std::sqrt(i*delta);
+    });
 
     return rv;
 }
@@ -26,6 +26,7 @@
 #include "SM/WakePotentialMap.hpp"
 #include "IO/HDF5File.hpp"
 #include "IO/ProgramOptions.hpp"
+#include "IO/SharedMemorySink.hpp"
 
 #include <chrono>
 #include <climits>
@@ -90,6 +91,7 @@ int main(int argc, char** argv)
 
     #if DEBUG != 1
     if (ofname.empty() && !opts.getForceRun() && cldev >= 0
+        && opts.getSharedMemory().empty()
         #if INOVESA_USE_OPENGL == 1
         && !opts.showPhaseSpace()
         #endif // INOVESA_USE_OPENGL
@@ -98,7 +100,7 @@ int main(int argc, char** argv)
                      #if INOVESA_USE_OPENGL == 1
                      " 'gui',"
                      #endif // INOVESA_USE_OPENGL
-                     " 'output', or"
+                     " 'output', 'SharedMemory', or"
                      " 'run_anyway'." << std::endl;
         return EXIT_SUCCESS;
     }
@@ -136,7 +138,14 @@ int main(int argc, char** argv)
             oclh = std::make_shared<OCLH>( opts.getCLDevice()-1
                                          #if INOVESA_USE_OPENGL == 1
                                          , opts.showPhaseSpace()
+                                         #else
+                                         , false
                                          #endif // INOVESA_USE_OPENGL
+                                         , opts.getCLOutOfOrder()
+                                         , opts.getCLTune()
+                                         // only fused kernels are split
+                                         , opts.getCLFusedStep()
+                                           ? opts.getCLDevices() : 1
                                          );
         } catch (cl::Error& e) {
             Display::printText(e.what());
@@ -295,13 +304,13 @@ int main(int argc, char** argv)
     double padding =std::max(opts.getPadding(),1.0);
 
     size_t padded_bins = std::ceil(ps_bins*padding);
-    if (opts.getRoundPadding()) {
-        padded_bins = Impedance::upper_power_of_two(padded_bins);
-    }
-
     size_t spaced_bins = std::ceil(ps_bins*nbuckets*spacing_ps);
     if (opts.getRoundPadding()) {
-        spaced_bins = Impedance::upper_power_of_two(spaced_bins);
+        /* FFTW is efficient for sizes 2^a*3^b*5^c,
+         * so there is no need to go up to the next power of two.
+         */
+        padded_bins = Impedance::upper_smooth_number(padded_bins);
+        spaced_bins = Impedance::upper_smooth_number(spaced_bins);
     }
 
 
@@ -511,6 +520,12 @@ int main(int argc, char** argv)
         grid_t1->updateXProjection();
 
         grid_t1->normalize(); // works on XProjection
+        #if INOVESA_USE_OPENCL == 1
+        if (oclh) {
+            // normalization is done on the device, host data is used below
+            grid_t1->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+        }
+        #endif // INOVESA_USE_OPENCL
     }
 
     auto grid_t2 = std::make_shared<PhaseSpace>(*grid_t1);
@@ -574,7 +589,7 @@ int main(int argc, char** argv)
 
     // RF map
     std::shared_ptr<DynamicRFKickMap> drfm;
-    std::shared_ptr<SourceMap> rfm;
+    std::shared_ptr<RFKickMap> rfm;
     if ( rf_phase_noise != 0 || rf_ampl_noise != 0
       || (rf_mod_ampl != 0 && rf_mod_step != 0)) {
         if (linearRF) {
@@ -583,7 +598,7 @@ int main(int argc, char** argv)
             drfm.reset(new DynamicRFKickMap( grid_t2, grid_t1,ps_bins, ps_bins
                                            , angle, revolutionpart, f_RF
                                            , rf_phase_noise, rf_ampl_noise
-                                           , rf_mod_ampl,rf_mod_step, laststep
+                                           , rf_mod_ampl,rf_mod_step
                                            , interpolationtype,interpol_clamp
                                            , oclh
                                            ));
@@ -593,7 +608,7 @@ int main(int argc, char** argv)
             drfm.reset(new DynamicRFKickMap( grid_t2, grid_t1,ps_bins, ps_bins
                                            , revolutionpart, V_eff, f_RF, V0
                                            , rf_phase_noise, rf_ampl_noise
-                                           , rf_mod_ampl,rf_mod_step, laststep
+                                           , rf_mod_ampl,rf_mod_step
                                            , interpolationtype,interpol_clamp
                                            , oclh
                                            ));
@@ -672,11 +687,13 @@ int main(int argc, char** argv)
 
     // SourceMap for damping and diffusion
     SourceMap* fpm;
+    FokkerPlanckMap* fpmap = nullptr;
     if (e1 > 0) {
         Display::printText("Building FokkerPlanckMap.");
-        fpm = new FokkerPlanckMap( grid_t3,grid_t1,ps_bins,ps_bins
-                                 , fptype,fptrack,e1, derivationtype, oclh
-                                 );
+        fpmap = new FokkerPlanckMap( grid_t3,grid_t1,ps_bins,ps_bins
+                                   , fptype,fptrack,e1, derivationtype, oclh
+                                   );
+        fpm = fpmap;
 
         sstream.str("");
         sstream << std::scientific << calc_damp << " s";
@@ -702,6 +719,22 @@ int main(int argc, char** argv)
      * one for beam dynamics and one for CSR.
      */
 
+    sstream.str("");
+    sstream << "Padding bunch profile to " << padded_bins << " bins";
+    if (nbuckets > 1) {
+        sstream << ", bunch train to " << spaced_bins << " bins";
+    }
+    if (opts.getRoundPadding()) {
+        sstream << " (next power of two: "
+                << Impedance::upper_power_of_two(padded_bins);
+        if (nbuckets > 1) {
+            sstream << ", " << Impedance::upper_power_of_two(spaced_bins);
+        }
+        sstream << ')';
+    }
+    sstream << '.';
+    Display::printText(sstream.str());
+
     Display::printText("For beam dynamics computation:");
     std::shared_ptr<Impedance> wake_impedance
             = vfps::makeImpedance( (filling.size()>0)? spaced_bins : padded_bins
@@ -847,14 +880,69 @@ int main(int argc, char** argv)
      */
     #if INOVESA_USE_HDF5 == 1
     HDF5File* hdf_file = nullptr;
+
+    // cadences (in simulation steps) of the groups of results
+    auto cadence = [outstep](const uint32_t n) { return (n > 0)? n : outstep; };
+    const uint32_t outstep_moments = cadence(opts.getOutstepMoments());
+    const uint32_t outstep_profiles = cadence(opts.getOutstepProfiles());
+    const uint32_t outstep_spectra = cadence(opts.getOutstepSpectra());
+    const uint32_t outstep_wake = cadence(opts.getOutstepWake());
+    const uint32_t outstep_tracks = cadence(opts.getOutstepTracks());
+    const uint32_t outstep_phasespace = outstep*opts.getSavePhaseSpace();
+
     if ( isOfFileType(".h5",ofname)
       || isOfFileType(".hdf5",ofname) ) {
         opts.save(ofname+".cfg");
         Display::printText("Saved configuiration to \""+ofname+".cfg\".");
         try {
+            HDF5File::OutputProfile profile( opts.getOutputProfile()
+                                           , opts.getOutputOverrides());
+            if (opts.getCompressionLevel() > 9) {
+                throw std::invalid_argument("CompressionLevel has to be"
+                                            " 0 to 9 (or -1).");
+            }
+            if (opts.getCompressionLevel() >= 0) {
+                profile.defaults.compression = opts.getCompressionLevel();
+            }
+            profile.quantize = opts.getQuantizeOutput();
+            profile.snapshots = opts.getPhaseSpaceSnapshots();
+            profile.snapshotthreshold = opts.getSnapshotThreshold();
+            profile.keyframeinterval = opts.getSnapshotKeyframes();
+            HDF5File::SpectrumSettings spectrum( opts.getCSRSpectrumFMin()
+                                               , opts.getCSRSpectrumFMax()
+                                               , opts.getCSRSpectrumBins()
+                                               , opts.getCSRSpectrumLogBins());
+            std::set<HDF5File::OutputGroup> ownaxes;
+            for (const auto& group : { std::make_pair( outstep_profiles
+                                                     , HDF5File::OutputGroup::Profiles)
+                                     , std::make_pair( outstep_spectra
+                                                     , HDF5File::OutputGroup::Spectra)
+                                     , std::make_pair( outstep_wake
+                                                     , HDF5File::OutputGroup::Wake)
+                                     , std::make_pair( outstep_tracks
+                                                     , HDF5File::OutputGroup::Tracks)}) {
+                if (group.first != outstep_moments) {
+                    ownaxes.insert(group.second);
+                }
+            }
             hdf_file = new HDF5File(ofname,grid_t1, &rdtn_field, wake_impedance,
-                                    wfm,trackme.size(), t_sync,f_rev);
+                                    wfm,trackme.size(), t_sync,f_rev,
+                                    size_t(opts.getOutputBuffer())<<20,
+                                    opts.getCompressionThreads(),
+                                    profile,
+                                    opts.getSWMRInterval(),
+                                    spectrum,
+                                    ownaxes);
             Display::printText("Will save results to \""+ofname+"\".");
+            if (opts.getOutputBuffer() > 0) {
+                Display::printText("Results are written by a background thread.");
+            }
+            #if INOVESA_USE_ZLIB == 0
+            if (opts.getCompressionThreads() > 0) {
+                Display::printText("Parallel compression is not available "
+                                   "in this build.");
+            }
+            #endif // INOVESA_USE_ZLIB
             opts.save(hdf_file);
             hdf_file->addParameterToGroup("/Info","CSRStrength",
                                           H5::PredType::IEEE_F64LE,&S_csr);
@@ -867,6 +955,9 @@ int main(int argc, char** argv)
            e.printErrorStack();
            #endif
             Display::abort = true;
+        } catch (std::invalid_argument& e) {
+            Display::printText(e.what());
+            return EXIT_SUCCESS;
         }
     } else
     #endif // INOVESA_USE_HDF5
@@ -884,6 +975,29 @@ int main(int argc, char** argv)
         return EXIT_SUCCESS;
     }
 
+    // can be used in addition to (or instead of) the output file
+    #if INOVESA_USE_SHM == 1
+    std::unique_ptr<SharedMemorySink> shm_sink;
+    if (!opts.getSharedMemory().empty()) {
+        try {
+            shm_sink = std::make_unique<SharedMemorySink>(
+                        opts.getSharedMemory(),
+                        opts.getSharedMemorySlots(),
+                        opts.getSharedMemoryPhaseSpace());
+            Display::printText("Will publish results to shared memory \""
+                               +opts.getSharedMemory()+"\".");
+        } catch (std::runtime_error& e) {
+            Display::printText(e.what());
+            return EXIT_SUCCESS;
+        }
+    }
+    #else
+    if (!opts.getSharedMemory().empty()) {
+        Display::printText("Shared memory output is not available "
+                           "in this build.");
+    }
+    #endif // INOVESA_USE_SHM
+
 
     Display::printText("Starting the simulation.");
 
@@ -903,8 +1017,12 @@ int main(int argc, char** argv)
     grid_t1->variance(1);
     Display::printText(status_string(grid_t1,0,rotations),false);
 
+    // column-local maps are combined (only makes a difference for OpenCL)
+    const bool fusedstep = opts.getCLFusedStep();
+
     #if INOVESA_USE_HDF5 == 1
     const auto h5save = opts.getSavePhaseSpace();
+    const bool csr_perstep = opts.getCSRIntensityPerStep();
     // end of preparation to save results
 
     if (hdf_file != nullptr) {
@@ -912,6 +1030,12 @@ int main(int argc, char** argv)
         if (wake_field != nullptr) {
             // padded bunch and wake profiles
             wake_field->wakePotential();
+            #if INOVESA_USE_OPENCL == 1
+            if (oclh) {
+                wake_field->downloadPadded();
+                oclh->finishDownloads();
+            }
+            #endif // INOVESA_USE_OPENCL
             hdf_file->appendPadded(wake_field);
         }
         if (h5save == 0) {
@@ -941,6 +1065,76 @@ int main(int argc, char** argv)
      */
     uint32_t simulationstep = 0;
 
+    #if INOVESA_USE_HDF5 == 1
+    double outtime = 0;
+    #endif // INOVESA_USE_HDF5
+
+    // results (and status output) due at the current output step
+    struct {
+        bool status, moments, profiles, spectra, wake, tracks, phasespace;
+    } outdue {false,false,false,false,false,false,false};
+
+    // the wake field (if any) already knows the current form factor
+    auto updateCSR = [&]() {
+        if (wake_field != nullptr) {
+            rdtn_field.updateCSR(*wake_field,fc);
+        } else {
+            rdtn_field.updateCSR(fc);
+        }
+    };
+
+    /*
+     * Output of data that has to be copied from the device first.
+     * (With OpenCL, this is done after the next step has been enqueued.)
+     */
+    bool outputpending = false;
+    auto finishOutput = [&]() {
+        #if INOVESA_USE_OPENCL == 1
+        if (oclh) {
+            oclh->finishDownloads();
+        }
+        #endif // INOVESA_USE_OPENCL
+        #if INOVESA_USE_HDF5 == 1
+        if (hdf_file != nullptr) {
+            if (outdue.moments) {
+                hdf_file->append(*grid_t1,outtime,HDF5File::AppendType::Moments);
+            }
+            if (outdue.profiles) {
+                hdf_file->append(*grid_t1,outtime,HDF5File::AppendType::Profiles);
+            }
+            if (outdue.phasespace) {
+                hdf_file->append(*grid_t1,outtime,HDF5File::AppendType::PhaseSpace);
+            }
+            if (outdue.wake) {
+                hdf_file->append(wkm,outtime);
+            }
+        }
+        #endif // INOVESA_USE_HDF5
+        #if INOVESA_USE_SHM == 1
+        if (shm_sink && outdue.status) {
+            shm_sink->publish( *grid_t1, &rdtn_field, simulationstep
+                             , static_cast<double>(simulationstep)/steps);
+        }
+        #endif // INOVESA_USE_SHM
+        #if INOVESA_USE_OPENGL == 1
+        if (display != nullptr && outdue.status) {
+            if (psv != nullptr) {
+                psv->createTexture(grid_t1);
+            }
+            if (bpv != nullptr && !bpv->getBufferShared()) {
+                bpv->update(grid_t1->getProjection(0));
+            }
+            if (wpv != nullptr && !wpv->getBufferShared()) {
+                wpv->update(wkm->getForce());
+            }
+            display->draw();
+            if (psv != nullptr) {
+                psv->delTexture();
+            }
+        }
+        #endif // INOVESA_USE_OPENGL
+    };
+
     while (simulationstep<laststep && !Display::abort) {
         if (wkm != nullptr) {
             // works on XProjection
@@ -953,89 +1147,150 @@ int main(int argc, char** argv)
             // works on XProjection
             grid_t1->integrate();
         }
+        #if INOVESA_USE_HDF5 == 1
+        if (hdf_file != nullptr && csr_perstep) {
+            updateCSR();
+            hdf_file->appendCSRIntensity(&rdtn_field,
+                        static_cast<double>(simulationstep)/steps);
+        }
+        #endif // INOVESA_USE_HDF5
+
+        auto due = [simulationstep](const uint32_t n) {
+            return n > 0 && simulationstep%n == 0;
+        };
+        outdue.status = due(outstep);
+        #if INOVESA_USE_HDF5 == 1
+        if (hdf_file != nullptr) {
+            outdue.moments = due(outstep_moments);
+            outdue.profiles = due(outstep_profiles);
+            outdue.spectra = due(outstep_spectra);
+            outdue.wake = (wkm != nullptr && due(outstep_wake));
+            outdue.tracks = due(outstep_tracks);
+            outdue.phasespace = due(outstep_phasespace);
+        }
+        #endif // INOVESA_USE_HDF5
 
-        if (outstep > 0 && simulationstep%outstep == 0) {
+        if ( outdue.status || outdue.moments || outdue.profiles
+          || outdue.spectra || outdue.wake || outdue.tracks
+          || outdue.phasespace) {
+            // only what will be shown or saved is computed
+            const bool moments = outdue.status || outdue.moments;
 
             // works on XProjection
             grid_t1->integrate();
-            grid_t1->variance(0);
-            grid_t1->updateYProjection();
-            grid_t1->variance(1);
+            if (moments) {
+                grid_t1->variance(0);
+            }
+            if (moments || outdue.profiles) {
+                grid_t1->updateYProjection();
+            }
+            if (moments) {
+                grid_t1->variance(1);
+            }
+            #if INOVESA_USE_HDF5 == 1
+            outtime = static_cast<double>(simulationstep)/steps;
+            #endif // INOVESA_USE_HDF5
             #if INOVESA_USE_OPENCL == 1
             if (oclh) {
-                grid_t1->syncCLMem(OCLH::clCopyDirection::dev2cpu);
-                if (wkm != nullptr) {
-                    wkm->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+                // the phase space itself is only transferred when needed
+                bool needdata = outdue.phasespace;
+                bool needprojections = outdue.profiles;
+                bool needwake = outdue.wake;
+                #if INOVESA_USE_SHM == 1
+                if (outdue.status && shm_sink) {
+                    needdata |= shm_sink->withPhaseSpace();
+                    needprojections = true;
+                }
+                #endif // INOVESA_USE_SHM
+                #if INOVESA_USE_OPENGL == 1
+                if (outdue.status) {
+                    needdata |= (psv != nullptr);
+                    needprojections |= (bpv != nullptr
+                                        && !bpv->getBufferShared());
+                    needwake |= (wpv != nullptr && !wpv->getBufferShared());
+                }
+                #endif // INOVESA_USE_OPENGL
+                if (needdata || needprojections) {
+                    grid_t1->download(needdata,needprojections);
+                }
+                if (wkm != nullptr && needwake) {
+                    wkm->download();
                 }
             }
             #endif // INOVESA_USE_OPENCL
+            bool csrupdated = false;
             #if INOVESA_USE_HDF5 == 1
             if (hdf_file != nullptr) {
-                HDF5File::AppendType at =
-                        (h5save > 0 && outstepnr%h5save == 0)
-                        ? HDF5File::AppendType::All
-                        : HDF5File::AppendType::Defaults;
-
-
-                hdf_file->append(*grid_t1,
-                        static_cast<double>(simulationstep)/steps, at);
-                rdtn_field.updateCSR(fc);
-                hdf_file->append(&rdtn_field);
-                if (wkm != nullptr) {
-                    hdf_file->append(wkm);
+                if (outdue.moments || outdue.spectra) {
+                    updateCSR();
+                    csrupdated = true;
+                    hdf_file->append( &rdtn_field, outtime
+                                    , outdue.moments, outdue.spectra);
                 }
-                hdf_file->appendTracks(trackme);
-
-                if (drfm) {
+                if (outdue.tracks) {
+                    hdf_file->appendTracks(trackme,outtime);
+                }
+                if (drfm && outdue.moments) {
                     hdf_file->appendRFKicks(drfm->getPastModulation());
                 }
             }
-            outstepnr++;
             #endif // INOVESA_USE_HDF5
-            #if INOVESA_USE_OPENGL == 1
-            if (display != nullptr) {
-                if (psv != nullptr) {
-                    psv->createTexture(grid_t1);
-                }
-                if (bpv != nullptr && !bpv->getBufferShared()) {
-                    bpv->update(grid_t1->getProjection(0));
-                }
-                if (ppv != nullptr) {
-                    ppv->update(trackme);
-                }
-                if (wpv != nullptr && !wpv->getBufferShared()) {
-                    wpv->update(wkm->getForce());
-                }
-                if (history != nullptr) {
-                    #if INOVESA_USE_HDF5 == 1
-                    if (hdf_file == nullptr)
-                    #endif // INOVESA_USE_HDF5
-                    {
-                        rdtn_field.updateCSR(fc);
+            #if INOVESA_USE_SHM == 1
+            if (shm_sink && outdue.status && !csrupdated) {
+                updateCSR();
+                csrupdated = true;
+            }
+            #endif // INOVESA_USE_SHM
+            if (outdue.status) {
+                #if INOVESA_USE_HDF5 == 1
+                outstepnr++;
+                #endif // INOVESA_USE_HDF5
+                #if INOVESA_USE_OPENGL == 1
+                if (display != nullptr) {
+                    if (ppv != nullptr) {
+                        ppv->update(trackme);
+                    }
+                    if (history != nullptr) {
+                        if (!csrupdated) {
+                            updateCSR();
+                        }
+                        csrlog[outstepnr] = rdtn_field.getCSRPower()[0];
+                        history->update(csrlog.data());
                     }
-                    csrlog[outstepnr] = rdtn_field.getCSRPower()[0];
-                    history->update(csrlog.data());
-                }
-                display->draw();
-                if (psv != nullptr) {
-                    psv->delTexture();
                 }
+                #endif // INOVESSA_USE_GUI
+                Display::printText(status_string(grid_t1,static_cast<float>(simulationstep)/steps,
+                                   rotations),false,updatetime);
             }
-            #endif // INOVESSA_USE_GUI
-            Display::printText(status_string(grid_t1,static_cast<float>(simulationstep)/steps,
-                               rotations),false,updatetime);
+            outputpending = true;
+        }
+        if (outputpending && oclh == nullptr) {
+            // without OpenCL, the maps would change the data right away
+            finishOutput();
+            outputpending = false;
+        }
+        if (fusedstep && wkm != nullptr) {
+            // grid_t2 is skipped, both kicks work on grid_t1
+            rfm->applyFused(*wkm);
+        } else {
+            wm->apply();
+            rfm->apply();
         }
-        wm->apply();
         wm->applyTo(trackme);
-        rfm->apply();
         rfm->applyTo(trackme);
         drm->apply();
         drm->applyTo(trackme);
-        fpm->apply();
-        fpm->applyTo(trackme);
+        if (fusedstep && fpmap != nullptr) {
+            // also updates XProjection for next time step
+            fpmap->applyAndUpdateXProjection();
+            fpm->applyTo(trackme);
+        } else {
+            fpm->apply();
+            fpm->applyTo(trackme);
 
-        // udate for next time step
-        grid_t1->updateXProjection();
+            // udate for next time step
+            grid_t1->updateXProjection();
+        }
 
         #if INOVESA_USE_OPENCL == 1
         if (oclh) {
@@ -1043,6 +1298,12 @@ int main(int argc, char** argv)
         }
         #endif // INOVESA_USE_OPENCL
 
+        // transfers started at the output step overlap with this step
+        if (outputpending) {
+            finishOutput();
+            outputpending = false;
+        }
+
         simulationstep++;
     } // end of main simulation loop
 
@@ -1068,22 +1329,26 @@ int main(int argc, char** argv)
         grid_t1->variance(1);
         #if INOVESA_USE_OPENCL == 1
         if (oclh) {
-            grid_t1->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+            grid_t1->download(true);
             if (wkm != nullptr) {
-                wkm->syncCLMem(OCLH::clCopyDirection::dev2cpu);
+                wkm->download();
+            }
+            if (wake_field != nullptr) {
+                wake_field->downloadPadded();
             }
+            oclh->finishDownloads();
         }
         #endif // INOVESA_USE_OPENCL
         // for theresult, everything will be saved
         hdf_file->append(*grid_t1,
                          static_cast<double>(simulationstep)/steps,
                          HDF5File::AppendType::All);
-        rdtn_field.updateCSR(fc);
-        hdf_file->append(&rdtn_field);
+        updateCSR();
+        hdf_file->append(&rdtn_field,static_cast<double>(simulationstep)/steps);
         if (wkm != nullptr) {
-            hdf_file->append(wkm);
+            hdf_file->append(wkm,static_cast<double>(simulationstep)/steps);
         }
-        hdf_file->appendTracks(trackme);
+        hdf_file->appendTracks(trackme,static_cast<double>(simulationstep)/steps);
 
         if (drfm) {
             hdf_file->appendRFKicks(drfm->getPastModulation());
@@ -1091,6 +1356,9 @@ int main(int argc, char** argv)
         if (wake_field != nullptr) {
             hdf_file->appendPadded(wake_field);
         }
+        // writes queued data (also when aborted by SIGINT)
+        delete hdf_file;
+        hdf_file = nullptr;
     }
     #endif // INOVESA_USE_HDF5
     #if INOVESA_USE_PNG == 1
@@ -0,0 +1,209 @@
+#include <boost/test/unit_test.hpp>
+
+#include "defines.hpp"
+
+#if INOVESA_USE_HDF5 == 1
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#define INOVESA_ALLOW_PS_RESET 1
+#include "IO/HDF5File.hpp"
+
+namespace {
+
+constexpr vfps::meshindex_t ps_size = 32;
+
+/**
+ * @brief frame phase space of step, occupying only some of the cells
+ *
+ * In step 2, all cells are occupied, so they touch the edges of the grid.
+ */
+std::vector<vfps::meshdata_t> frame(const size_t step)
+{
+    std::vector<vfps::meshdata_t> rv(ps_size*ps_size,0);
+    const double c = (step == 2)? 10 : 14+step;
+    const double r = (step == 2)? 30 : 8;
+    const double w = (step == 2)? 200 : 2+step;
+    for (size_t x=0; x<ps_size; x++) {
+        for (size_t y=0; y<ps_size; y++) {
+            const double d2 = std::pow(x-c,2)+std::pow(y-c-step%2,2);
+            if (d2 < r*r) {
+                rv[x*ps_size+y] = std::exp(-d2/w)/(1+step);
+            }
+        }
+    }
+    return rv;
+}
+
+/**
+ * @brief writeFrames saves the phase spaces of nsteps steps
+ */
+void writeFrames( const std::string& fname
+                , const vfps::HDF5File::OutputProfile& profile
+                , const size_t nsteps)
+{
+    vfps::PhaseSpace::resetSize(ps_size,1);
+    auto ps = std::make_shared<vfps::PhaseSpace>(-12,12,1,-12,12,1,nullptr,1,1);
+    vfps::HDF5File file(fname,ps,nullptr,nullptr,nullptr,0,1,1
+                       ,0,0,profile);
+    for (size_t step=0; step<nsteps; step++) {
+        const auto data = frame(step);
+        std::copy(data.begin(),data.end(),ps->getData());
+        file.append(*ps,step,vfps::HDF5File::AppendType::PhaseSpace);
+    }
+}
+
+std::unique_ptr<vfps::PhaseSpace> readFrame( const std::string& fname
+                                           , const int64_t step)
+{
+    vfps::PhaseSpace::resetSize();
+    return vfps::HDF5File::readPhaseSpace( fname,-12,12,-12,12,nullptr
+                                         , 1,1,1,1,step);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( hdf5_output_profile ){
+    using vfps::HDF5File;
+
+    HDF5File::OutputProfile profile("fast","PhaseSpace:compression=9,"
+                                           "chunk=1x1x16x16;;CSR/Spectrum:shuffle=0");
+    BOOST_CHECK_EQUAL(profile.defaults.compression, 1);
+    BOOST_CHECK_EQUAL(profile.get("/PhaseSpace/data").compression, 9);
+    BOOST_CHECK_EQUAL(profile.get("/PhaseSpace/data").chunkdims.size(), 4);
+    BOOST_CHECK_EQUAL(profile.get("/CSR/Spectrum").shuffle, false);
+    BOOST_CHECK_EQUAL(profile.get("/BunchProfile/data").compression, 1);
+
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("none"), std::invalid_argument);
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("balanced","=gzip:4"),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("balanced",":compression=4"),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("balanced","PhaseSpace:compression=10"),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("balanced","PhaseSpace:compression=-1"),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(HDF5File::OutputProfile("balanced","PhaseSpace:level=1"),
+                      std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( hdf5_quantized_phasespace ){
+    namespace fs = boost::filesystem;
+    const std::string fname = (fs::temp_directory_path()
+            / fs::unique_path("inovesa-quantized-%%%%-%%%%.h5")).string();
+    const size_t nsteps = 4;
+
+    vfps::HDF5File::OutputProfile profile;
+    profile.quantize = true;
+    writeFrames(fname,profile,nsteps);
+
+    for (size_t step=0; step<nsteps; step++) {
+        const auto expected = frame(step);
+        const auto minmax = std::minmax_element(expected.begin(),expected.end());
+        // half a quantization step (plus rounding to meshdata_t)
+        const double bound = (*minmax.second-*minmax.first)/65535*0.5
+                + std::numeric_limits<vfps::meshdata_t>::epsilon()*(*minmax.second);
+
+        const auto ps = readFrame(fname,step);
+        double maxerror = 0;
+        for (size_t i=0; i<expected.size(); i++) {
+            maxerror = std::max<double>( maxerror
+                                       , std::abs(ps->getData()[i]-expected[i]));
+        }
+        BOOST_CHECK_LE(maxerror, bound);
+        BOOST_CHECK_GT(maxerror, 0);
+    }
+
+    fs::remove(fname);
+}
+
+BOOST_AUTO_TEST_CASE( hdf5_snapshot_phasespace ){
+    namespace fs = boost::filesystem;
+    const std::string fname = (fs::temp_directory_path()
+            / fs::unique_path("inovesa-snapshot-%%%%-%%%%.h5")).string();
+    const size_t nsteps = 6;
+
+    // keyframes in steps 0 and 3, the others are differences
+    vfps::HDF5File::OutputProfile profile;
+    profile.snapshots = true;
+    profile.keyframeinterval = 3;
+    writeFrames(fname,profile,nsteps);
+
+    {
+    H5::H5File file(fname,H5F_ACC_RDONLY);
+    H5::DataSet dataset = file.openDataSet("/PhaseSpace/snapshot/index");
+    std::vector<uint64_t> index(nsteps*6);
+    dataset.read(index.data(),H5::PredType::NATIVE_UINT64);
+    for (size_t step=0; step<nsteps; step++) {
+        BOOST_CHECK_EQUAL(index[step*6+5], step%3 == 0);
+    }
+    // cropped, but not in step 2
+    BOOST_CHECK_GT(index[1*6+1], 0);
+    BOOST_CHECK_LT(index[1*6+2], ps_size);
+    BOOST_CHECK_EQUAL(index[2*6+1], 0);
+    BOOST_CHECK_EQUAL(index[2*6+2], ps_size);
+    BOOST_CHECK_EQUAL(index[2*6+3], 0);
+    BOOST_CHECK_EQUAL(index[2*6+4], ps_size);
+    }
+
+    // every step (also between keyframes) is restored exactly
+    for (int64_t step=-1; step<static_cast<int64_t>(nsteps); step++) {
+        const auto expected = frame((nsteps+step)%nsteps);
+        const auto ps = readFrame(fname,step);
+        for (size_t i=0; i<expected.size(); i++) {
+            BOOST_REQUIRE_EQUAL(ps->getData()[i], expected[i]);
+        }
+    }
+    fs::remove(fname);
+
+    // cells below the threshold are dropped
+    profile.snapshotthreshold = 1e-3;
+    writeFrames(fname,profile,nsteps);
+    for (size_t step=0; step<nsteps; step++) {
+        const auto expected = frame(step);
+        const auto maxval = *std::max_element(expected.begin(),expected.end());
+        const auto ps = readFrame(fname,step);
+        for (size_t i=0; i<expected.size(); i++) {
+            const vfps::meshdata_t value = ps->getData()[i];
+            if (value != expected[i]) {
+                BOOST_REQUIRE_EQUAL(value, 0);
+                BOOST_REQUIRE_LE(expected[i], profile.snapshotthreshold*maxval);
+            }
+        }
+    }
+    fs::remove(fname);
+}
+
+BOOST_AUTO_TEST_CASE( hdf5_large_rows ){
+    namespace fs = boost::filesystem;
+    const std::string fname = (fs::temp_directory_path()
+            / fs::unique_path("inovesa-large-%%%%-%%%%.h5")).string();
+
+    // 4 MiB per row, default chunks would hold 64 rows
+    vfps::PhaseSpace::resetSize(1024,1);
+    auto ps = std::make_shared<vfps::PhaseSpace>(-12,12,1,-12,12,1,nullptr,1,1);
+    {
+    vfps::HDF5File file(fname,ps,nullptr,nullptr,nullptr,0,1,1
+                       ,0,0,vfps::HDF5File::OutputProfile());
+    }
+
+    H5::H5File file(fname,H5F_ACC_RDONLY);
+    H5::DataSet dataset = file.openDataSet("/PhaseSpace/data");
+    std::array<hsize_t,4> chunkdims;
+    dataset.getCreatePlist().getChunk(4,chunkdims.data());
+    // two rows fit maxbufferbytes
+    BOOST_CHECK_EQUAL(chunkdims[0], 2);
+
+    fs::remove(fname);
+    // other tests expect the usual size
+    vfps::PhaseSpace::resetSize(ps_size,1);
+}
+
+#endif // INOVESA_USE_HDF5
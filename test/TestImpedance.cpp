@@ -0,0 +1,60 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+
+#include "defines.hpp"
+#include "Z/ConstImpedance.hpp"
+#include "Z/Impedance.hpp"
+
+BOOST_AUTO_TEST_CASE( impedance_fft_sizes ){
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_power_of_two(1025), 2048);
+
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(1), 1);
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(7), 8);
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(1024), 1024);
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(1025), 1080);
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(2049), 2160);
+    BOOST_CHECK_EQUAL(vfps::Impedance::upper_smooth_number(3126), 3200);
+}
+
+BOOST_AUTO_TEST_CASE( impedance_const_odd_size ){
+    const vfps::impedance_t Z(2,1);
+    for (size_t n : {7,8}) {
+        vfps::ConstImpedance z(n,1,Z);
+        BOOST_REQUIRE_EQUAL(z.nFreqs(), n);
+        // all frequencies up to n/2 (the last non-redundant one)
+        for (size_t i=0; i<=n/2; i++) {
+            BOOST_CHECK_EQUAL(z[i], Z);
+        }
+        for (size_t i=n/2+1; i<n; i++) {
+            BOOST_CHECK_EQUAL(z[i], vfps::impedance_t(0,0));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( impedance_from_file ){
+    namespace fs = boost::filesystem;
+    const fs::path fname = fs::temp_directory_path()
+            / fs::unique_path("inovesa-impedance-%%%%-%%%%.txt");
+    {
+        std::ofstream os(fname.string());
+        // header, CSV separators, unsorted, no newline at the end
+        os << "# n Re(Z) Im(Z)\n"
+           << "4, 2.0e0, -4\n"
+           << "0\t0\t0\r\n"
+           << "2 1 -2";
+    }
+
+    for (auto i=0; i<2; i++) { // second time, the binary copy is used
+        vfps::Impedance z(fname.string(),11,1,10);
+        BOOST_CHECK_EQUAL(z.nFreqs(), 11);
+        BOOST_CHECK_CLOSE(z[1].real(), 0.5f, 1e-4f);
+        BOOST_CHECK_CLOSE(z[3].imag(), -3.0f, 1e-4f);
+        BOOST_CHECK_EQUAL(z[4], vfps::impedance_t(2,-4));
+        BOOST_CHECK_EQUAL(z[5], vfps::impedance_t(0,0));
+    }
+
+    fs::remove(fname);
+    fs::remove(fname.string()+".inovesa-cache");
+}
@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include "defines.hpp"
+
+#if INOVESA_USE_OPENCL == 1
+
+#include <memory>
+#include <vector>
+
+#include "CL/OpenCLHandler.hpp"
+
+/* Needs an OpenCL device, e.g. a CPU using pocl.
+ * (pocl supports device fission, so sub-devices are tested.)
+ */
+BOOST_AUTO_TEST_CASE( opencl_column_blocks ){
+    const std::string code = R"(
+        __kernel void column(const __global data_t* in,
+                             const uint rows,
+                             __global data_t* out)
+        {
+            const uint c = get_group_id(0);
+            for (uint r=get_local_id(0); r<rows; r+=get_local_size(0)) {
+                out[c*rows+r] = 2*in[c*rows+r]+1;
+            }
+        }
+        )";
+    const cl_uint rows = 24;
+    const size_t ncols = 1001;
+    std::vector<vfps::meshdata_t> in(rows*ncols);
+    for (size_t i=0; i<in.size(); i++) {
+        in[i] = i;
+    }
+
+    for (const bool outoforder : {false, true}) {
+        std::unique_ptr<OCLH> oclh;
+        try {
+            oclh.reset(new OCLH(0,false,outoforder,false,2));
+        } catch (cl::Error& e) {
+            BOOST_TEST_MESSAGE("No OpenCL device available.");
+            return;
+        }
+        BOOST_CHECK_LE(oclh->devices(), 2);
+
+        const size_t bytes = sizeof(vfps::meshdata_t)*in.size();
+        cl::Buffer inbuf(oclh->context,CL_MEM_READ_WRITE,bytes);
+        cl::Buffer outbuf(oclh->context,CL_MEM_READ_WRITE,bytes);
+        oclh->enqueueWriteBuffer(inbuf,CL_TRUE,0,bytes,in.data());
+
+        cl::Kernel kernel(oclh->prepareCLProg(code),"column");
+        kernel.setArg(1,rows);
+        const size_t colbytes = sizeof(vfps::meshdata_t)*rows;
+        oclh->enqueueColumnBlocks( {{inbuf},{outbuf}}
+                                 , kernel
+                                 , {{0,inbuf,colbytes},{2,outbuf,colbytes}}
+                                 , ncols
+                                 , 8);
+
+        // (later) commands on the main queue see the results of all blocks
+        std::vector<vfps::meshdata_t> out(in.size());
+        oclh->enqueueReadBuffer(outbuf,CL_TRUE,0,bytes,out.data());
+        for (size_t i=0; i<in.size(); i++) {
+            BOOST_REQUIRE_EQUAL(out[i], 2*in[i]+1);
+        }
+    }
+}
+
+#endif // INOVESA_USE_OPENCL